@@ -13,12 +13,51 @@
 ***************************************************************/
 
 #include <gpac/filters.h>
+#include <gpac/thread.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
 
+/* SIMD kernels are picked per target; x86 AVX2 is additionally checked at runtime */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define BMP_HAS_SSE2
+	#if defined(__GNUC__) || defined(__clang__)
+		#include <immintrin.h>
+		#define BMP_HAS_AVX2
+	#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define BMP_HAS_NEON
+#endif
+
+#if defined(__wasm_simd128__)
+	#include <wasm_simd128.h>
+	#define BMP_HAS_SIMD128
+#endif
+
+/* Process-wide tables are filled once, whichever instance gets there first */
+#if defined(GPAC_DISABLE_THREADS)
+	typedef Bool BMP_Once;
+	#define BMP_ONCE_INIT	GF_FALSE
+	#define BMP_CALL_ONCE( _once, _fn )	if ( !( _once ) ) { ( _once ) = GF_TRUE; _fn( ); }
+#elif defined(WIN32) || defined(_WIN32_WCE)
+	#include <windows.h>
+	typedef INIT_ONCE BMP_Once;
+	#define BMP_ONCE_INIT	INIT_ONCE_STATIC_INIT
+	static BOOL CALLBACK BMP_OnceCall( PINIT_ONCE once, PVOID fn, PVOID *ctx ) { ( (void (*)( void )) fn )( ); return TRUE; }
+	#define BMP_CALL_ONCE( _once, _fn )	InitOnceExecuteOnce( &( _once ), BMP_OnceCall, (PVOID) _fn, NULL )
+#else
+	#include <pthread.h>
+	typedef pthread_once_t BMP_Once;
+	#define BMP_ONCE_INIT	PTHREAD_ONCE_INIT
+	#define BMP_CALL_ONCE( _once, _fn )	pthread_once( &( _once ), _fn )
+#endif
 
 /* Type definitions */
 #ifndef UINT 
@@ -77,35 +116,230 @@ struct BMP_Header
 };
 
 
-/* Private data structure */
+/* Heap accounting of one filter instance */
+struct BMP_AllocStats
+{
+	GF_Mutex*	Mutex;			/* frames may be released or decoded from other threads */
+	u64			LiveBytes;		/* bytes currently allocated */
+	u32			LiveAllocs;		/* blocks currently allocated */
+	u64			TotalAllocs;	/* allocations made since the instance was created */
+};
+
+/* Largest upscale factor */
+#define BMP_MAX_ZOOM		4
+
+/* Palette classes, each expanded by its own kernels. Black/white and white/black
+   output is a plain mask of the source bits, two greys a mask turned into two
+   byte values; pixels whose bytes differ need the color patterns */
+#define BMP_PALETTE_ANY			0
+#define BMP_PALETTE_BLACK_WHITE	1	/* color 0 all 0x00 bytes, color 1 all 0xFF */
+#define BMP_PALETTE_WHITE_BLACK	2	/* color 0 all 0xFF bytes, color 1 all 0x00 */
+#define BMP_PALETTE_GREYS		3	/* each color made of one repeated byte */
+#define BMP_NB_PALETTES			4
+
+struct BMP_Kernels;
+
+/* Expansion tables built once per image from the two palette entries */
+struct BMP_Expand
+{
+	const struct BMP_Kernels*	Kernels;	/* row kernels of the filter instance */
+	u32			PixelFormat;		/* output pixel format */
+	UINT		PixelSize;			/* bytes written per source pixel: bytes per output pixel times Zoom */
+	UINT		Zoom;				/* upscale: output pixels per source pixel, in each direction */
+	UINT		Palette;			/* class of the two output pixels, BMP_PALETTE_... */
+	u64			Grey[ 2 ];			/* BMP_PALETTE_GREYS: the byte of color 0, and color 0 xor color 1, over a word */
+	UCHAR		LUT[ 256*8*4*BMP_MAX_ZOOM ];	/* BMP_PALETTE_ANY: the output of the 8 pixels of every possible source byte */
+	UCHAR		Pattern[ 2 ][ 128 ];	/* each color repeated over 32 pixels, for the SIMD kernels */
+	UCHAR		BitMask[ 128 ];		/* for each output byte of 32 pixels, mask of its source bit */
+	UCHAR		ByteIndex[ 128 ];	/* for each output byte of 32 pixels, index of its source byte */
+	UCHAR		Chroma[ 2 ][ 5 ][ 5 ];	/* YUV output: U and V of a block of k pixels, n of them color 1, as [ c ][ k ][ n ] */
+	UCHAR		Color[ 2 ][ 3 ];	/* the two RGB colors */
+	UINT		Scale;				/* downscale: source pixels per output pixel, in each direction */
+	u32			DownCount[ 256 ];	/* downscale: color-1 pixels of each block a source byte covers, one byte lane per block */
+	UCHAR		Shade[ 65 ][ 4 ];	/* downscale: output pixel of a whole block with n color-1 pixels */
+	UCHAR		BitCount[ 256 ];	/* resample: color-1 pixels of each source byte */
+	UCHAR		Level[ 256 ][ 4 ];	/* resample: output pixel covered by color 1 for n/255 of its area */
+};
+
+/* Expands one row of 1bpp source into the output pixel format */
+typedef void ( *BMP_ExpandRow )( UCHAR *dst, const UCHAR *src, UINT width, const struct BMP_Expand *ex );
+
+/* Row kernels for each palette class and number of bytes per source pixel */
+struct BMP_Kernels
+{
+	BMP_ExpandRow	Row[ BMP_NB_PALETTES ][ 4*BMP_MAX_ZOOM + 1 ];
+};
+
+/* Kernel choice and threading threshold tuned on the running machine */
+struct BMP_Profile
+{
+	UINT	KernelSet[ 5 ];		/* kernel set for 1 to 4 bytes per source pixel */
+	Bool	Tuned;				/* KernelSet comes from a benchmark, current or saved */
+	UINT	BandPixels;			/* minimum pixels of a band decoded by one thread, 0 if not tuned */
+};
+
+
+/* Most reduced levels of a pyramid */
+#define BMP_MAX_LEVELS		24
+
+/* A reduced level of a pyramid, half the size of the level above it (rounded up) */
+struct BMP_Level
+{
+	UCHAR*			Dst;			/* first row, top-down */
+	UINT			DstStride;
+	UINT			Width;
+	UINT			Height;
+};
+
+/* One decode, split in bands of rows that can be expanded independently */
+struct BMP_DecodeJob
+{
+	const UCHAR*	Src;			/* first source row, as stored in the file */
+	UINT			SrcStride;
+	UINT			SrcX;			/* first source column when it is not byte-aligned, Src then points to the row start */
+	UCHAR*			Dst;			/* first output row, top-down */
+	UINT			DstStride;
+	UCHAR*			DstU;			/* YUV output: first chroma rows, NULL for RGB formats */
+	UCHAR*			DstV;
+	UINT			ChromaStride;
+	UINT			ChromaStep;		/* 1: planar chroma, 2: interleaved U/V */
+	UINT			Width;			/* output size */
+	UINT			Height;
+	UINT			SrcWidth;		/* source size, differs from the output size when downscaling */
+	UINT			SrcHeight;
+	UINT			Scale;			/* downscale: source pixels per output pixel in each direction, 1 for none */
+	UINT			Zoom;			/* upscale: output pixels per source pixel in each direction, 1 for none */
+	UINT			Resample;		/* 1: any output size, each pixel shaded by the source area it covers */
+	UINT			Step;			/* preview: output pixels are source pixels Step apart in each direction, 1 for none */
+	const struct BMP_Level*	Levels;	/* pyramid: the reduced levels built along with the output, NbLevels of them */
+	UINT			NbLevels;
+	USHORT			Orientation;	/* 0: bottom-up source rows, 1: top-down */
+	UINT			RowsPerBand;
+	UINT			NbBands;
+	const struct BMP_Expand*	Expand;
+	BMP_ExpandRow	Kernel;
+};
+
+/* Persistent decode threads, the calling thread decodes bands as well */
+struct BMP_WorkerPool
+{
+	GF_Thread**		Threads;
+	UINT			NbThreads;
+	UINT			MinBandPixels;	/* images with fewer pixels per thread stay single-threaded */
+	GF_Mutex*		Mutex;			/* protects NextBand */
+	GF_Mutex*		JobMutex;		/* one job at a time, lazy frames may be decoded from consumer threads */
+	GF_Semaphore*	Start;			/* one notification per worker and job */
+	GF_Semaphore*	Done;			/* one notification per worker once the job has no band left */
+	const struct BMP_DecodeJob*	Job;
+	UINT			NbJobs;			/* batch runs: Job is an array, each job decoded whole as one band */
+	UINT			NextBand;
+	Bool			Exit;
+	struct BMP_AllocStats*	Stats;	/* accounting of the owning instance */
+};
+
+
+/* Output frame buffer, recycled once downstream releases its packet */
+struct BMP_FrameBuffer
+{
+	struct BMP_FrameBuffer*	Next;
+	u32			Size;
+	/* frame data follows, at BMP_FRAME_HEADER bytes from the start */
+};
+
+#define BMP_FRAME_HEADER	( ( sizeof( struct BMP_FrameBuffer ) + 15 ) & ~( (size_t) 15 ) )
+
+/* Bounded set of output frame buffers, keyed by size */
+struct BMP_FramePool
+{
+	GF_Mutex*	Mutex;			/* buffers come back from whichever thread releases the packet */
+	struct BMP_FrameBuffer*	Free;
+	u32			NbBuffers;		/* free and in flight */
+	u32			MaxBuffers;
+	struct BMP_AllocStats*	Stats;
+};
+
+/* Region of an image, in pixels */
+struct BMP_Rect
+{
+	UINT		Id;				/* index in the list the region comes from */
+	UINT		X;
+	UINT		Y;
+	UINT		Width;
+	UINT		Height;
+};
+
+/* Incremental decode of unframed input: only the header and up to 2 rows are buffered */
+struct BMP_Stream
+{
+	UCHAR*		Head;			/* file header and palette, collected up to the pixel data */
+	UINT		HeadSize;
+	UINT		HeadAlloc;
+	Bool		InImage;		/* header parsed, pixel rows pending */
+	UINT		Rows;			/* source rows decoded so far */
+	UCHAR*		Carry;			/* rows split across input blocks */
+	UINT		CarrySize;
+	UINT		CarryAlloc;
+	GF_FilterPacket*	Frame;		/* output frame being filled */
+	struct BMP_DecodeJob	Job;	/* decode of the whole frame, rows are run in chunks of it */
+};
+
+
+/* Decode plan of the last image, reused as is while the next ones have the same
+   header and palette bytes, as in image sequences */
+struct BMP_Plan
+{
+	UCHAR*		Head;			/* header and palette bytes the plan was made from */
+	UINT		HeadSize;
+	UINT		HeadAlloc;
+	Bool		Valid;
+	struct BMP_Header	Header;	/* validated header */
+	long		dataInd;		/* offset of the pixel data */
+	int			scanLinePadding;
+	struct BMP_DecodeJob	Job;	/* decode set up for it, source rows relative to the file start */
+};
+
+
+/* Private data structure, one per filter instance */
 struct BMP_struct
 {
 	struct BMP_Header	Header;
 	UCHAR*		Palette;
-	UCHAR*		Data;
-	
+	UINT		PaletteAlloc;		/* size of the Palette buffer, kept across frames */
+	struct BMP_Expand	Expand;
+	long		dataInd;			/* read index into the file data */
+	int			scanLinePadding;	/* row padding, in bits */
+	struct BMP_AllocStats	Stats;
+	struct BMP_Plan	Plan;
+	struct BMP_Kernels	Kernels;
 };
 
 
 /*********************************** Forward declarations **********************************/
-int		ReadHeader	( const char* bmp_data, const int size );
-int		ReadUINT	(  UINT* x, const char* bmp_data,  const int size );
-int		ReadINT	(  int* x, const char* bmp_data,  const int size );
-int		ReadUSHORT	(  USHORT *x, const char* bmp_data, const int size );
-int 	dec1(const char* bmp_data);
-int		BMP_GetWidth( );
-int		BMP_GetHeight( );
-
-/* BMP representation and helper variables*/
-struct BMP_struct * bmp;
-long dataInd;
-int scanLinePadding;
+void*	BMP_Malloc	( struct BMP_AllocStats* stats, size_t size );
+void*	BMP_Calloc	( struct BMP_AllocStats* stats, size_t count, size_t size );
+void	BMP_Free	( struct BMP_AllocStats* stats, void* ptr );
+int		ReadHeader	( struct BMP_struct* bmp, const char* bmp_data, const int size );
+int 	dec1( struct BMP_struct* bmp, struct BMP_DecodeJob* job, u32 pixelFormat, UCHAR* dst, UINT dstStride, struct BMP_WorkerPool* pool);
+void	GetPaletteColors( const struct BMP_struct* bmp, UCHAR color[ 2 ][ 3 ] );
+void	BuildExpandLUT( struct BMP_Expand* ex, const UCHAR color[ 2 ][ 3 ], u32 pixelFormat, UINT zoom );
+UINT	GetPixelSize( u32 pixelFormat );
+void	BuildShadeLUT( struct BMP_Expand* ex, UINT scale );
+void	BuildLevelLUT( struct BMP_Expand* ex );
+u64		GetFrameLayout( u32 pixelFormat, UINT width, UINT height, UINT* stride, UINT* strideUV );
+int		SetupDecodeJob( struct BMP_struct* bmp, const char* bmp_data, const int size, struct BMP_DecodeJob* job );
+int		UseDecodePlan( struct BMP_struct* bmp, const char* bmp_data, const int size, struct BMP_DecodeJob* job );
+void	SaveDecodePlan( struct BMP_struct* bmp, const char* bmp_data, const struct BMP_DecodeJob* job );
+void	InitKernelSets( );
+void	SetExpandKernels( struct BMP_Kernels* kernels, const UINT kernelSet[ 5 ] );
+Bool	TuneExpandKernels( struct BMP_Profile* profile, struct BMP_AllocStats* stats );
+int		BMP_GetWidth( const struct BMP_struct* bmp );
+int		BMP_GetHeight( const struct BMP_struct* bmp );
 
 
 /**************************************************************
 	Returns the image's width.
 **************************************************************/
-int BMP_GetWidth(  )
+int BMP_GetWidth( const struct BMP_struct* bmp )
 {
 	if ( bmp == NULL )
 		return 0;
@@ -117,7 +351,7 @@ int BMP_GetWidth(  )
 /**************************************************************
 	Returns the image's height.
 **************************************************************/
-int BMP_GetHeight( )
+int BMP_GetHeight( const struct BMP_struct* bmp )
 {
 	if ( bmp == NULL )
 		return 0;
@@ -128,373 +362,3469 @@ int BMP_GetHeight( )
 /*********************************** Private methods **********************************/
 
 
+/* every block starts with its size, padded to keep the payload aligned */
+#define BMP_ALLOC_HEADER	16
+
 /**************************************************************
-	Reads the BMP file and DIB headers into the data structure.
-	Returns BMP_OK on success.
+	Allocates memory accounted to a filter instance.
+	Returns NULL on failure.
+**************************************************************/
+void* BMP_Malloc( struct BMP_AllocStats* stats, size_t size )
+{
+	UCHAR *block = (UCHAR*) malloc( size + BMP_ALLOC_HEADER );
+
+	if ( block == NULL )
+		return NULL;
+
+	*( (size_t*) block ) = size;
+	if ( stats->Mutex ) gf_mx_p( stats->Mutex );
+	stats->LiveBytes += size;
+	stats->LiveAllocs++;
+	stats->TotalAllocs++;
+	if ( stats->Mutex ) gf_mx_v( stats->Mutex );
+	return block + BMP_ALLOC_HEADER;
+}
+
+
+/**************************************************************
+	Same as BMP_Malloc, with the memory zeroed.
+**************************************************************/
+void* BMP_Calloc( struct BMP_AllocStats* stats, size_t count, size_t size )
+{
+	void *ptr = BMP_Malloc( stats, count * size );
+
+	if ( ptr != NULL )
+		memset( ptr, 0, count * size );
+	return ptr;
+}
+
+
+/**************************************************************
+	Releases memory from BMP_Malloc/BMP_Calloc. NULL is ignored.
+**************************************************************/
+void BMP_Free( struct BMP_AllocStats* stats, void* ptr )
+{
+	UCHAR *block;
+
+	if ( ptr == NULL )
+		return;
+
+	block = (UCHAR*) ptr - BMP_ALLOC_HEADER;
+	if ( stats->Mutex ) gf_mx_p( stats->Mutex );
+	stats->LiveBytes -= *( (size_t*) block );
+	stats->LiveAllocs--;
+	if ( stats->Mutex ) gf_mx_v( stats->Mutex );
+	free( block );
+}
+
+
+
+/* Little-endian loads from any byte address */
+#define BMP_LE16( p )	( (UINT) (p)[ 0 ] | (UINT) (p)[ 1 ] << 8 )
+#define BMP_LE32( p )	( (UINT) (p)[ 0 ] | (UINT) (p)[ 1 ] << 8 | (UINT) (p)[ 2 ] << 16 | (UINT) (p)[ 3 ] << 24 )
+
+/* One header field: its offset from the start of the file and its width in the
+   file, and where it is stored in struct BMP_Header */
+struct BMP_HeaderField
+{
+	UCHAR	Offset;
+	UCHAR	Size;		/* 2 or 4 bytes in the file */
+	UCHAR	FieldSize;	/* sizeof the USHORT or UINT member */
+	USHORT	Field;		/* offsetof the member */
+};
+
+#define BMP_FIELD( offset, size, member ) \
+	{ offset, size, sizeof( ( (struct BMP_Header*) 0 )->member ), offsetof( struct BMP_Header, member ) }
+
+/* 14-byte file header, followed by the size of the DIB header */
+static const struct BMP_HeaderField BMP_FileFields[] =
+{
+	BMP_FIELD(  0, 2, Magic ),
+	BMP_FIELD(  2, 4, FileSize ),
+	BMP_FIELD(  6, 2, Reserved1 ),
+	BMP_FIELD(  8, 2, Reserved2 ),
+	BMP_FIELD( 10, 4, DataOffset ),
+	BMP_FIELD( 14, 4, HeaderSize ),
+};
+
+/* OS/2 and Win 2.x BITMAPCOREHEADER, 16-bit dimensions */
+static const struct BMP_HeaderField BMP_CoreFields[] =
+{
+	BMP_FIELD( 18, 2, Width ),
+	BMP_FIELD( 20, 2, Height ),
+	BMP_FIELD( 22, 2, Planes ),
+	BMP_FIELD( 24, 2, BitsPerPixel ),
+};
+
+/* BITMAPINFOHEADER, then the color masks of the V2 and later headers */
+static const struct BMP_HeaderField BMP_InfoFields[] =
+{
+	BMP_FIELD( 18, 4, Width ),
+	BMP_FIELD( 22, 4, Height ),
+	BMP_FIELD( 26, 2, Planes ),
+	BMP_FIELD( 28, 2, BitsPerPixel ),
+	BMP_FIELD( 30, 4, CompressionType ),
+	BMP_FIELD( 34, 4, ImageDataSize ),
+	BMP_FIELD( 38, 4, HPixelsPerMeter ),
+	BMP_FIELD( 42, 4, VPixelsPerMeter ),
+	BMP_FIELD( 46, 4, ColorsUsed ),
+	BMP_FIELD( 50, 4, ColorsRequired ),
+	BMP_FIELD( 54, 4, RedMask.mask ),
+	BMP_FIELD( 58, 4, GreenMask.mask ),
+	BMP_FIELD( 62, 4, BlueMask.mask ),
+};
+
+#define BMP_INFO_FIELDS		10	/* BMP_InfoFields entries without the masks */
+
+/* Supported DIB headers. Whatever follows the masks (alpha mask, color space,
+   ICC profile) has no bearing on the decode and is skipped */
+static const struct BMP_HeaderVariant
+{
+	UINT	HeaderSize;
+	const struct BMP_HeaderField*	Fields;
+	UINT	NbFields;
+	USHORT	PaletteElementSize;
+	Bool	Signed;		/* a negative height means a top-down bitmap */
+} BMP_HeaderVariants[] =
+{
+	{  12, BMP_CoreFields, 4, 3, GF_FALSE },					/* BITMAPCOREHEADER */
+	{  40, BMP_InfoFields, BMP_INFO_FIELDS, 4, GF_TRUE },		/* BITMAPINFOHEADER */
+	{  52, BMP_InfoFields, BMP_INFO_FIELDS + 3, 4, GF_TRUE },	/* BITMAPV2INFOHEADER */
+	{  56, BMP_InfoFields, BMP_INFO_FIELDS + 3, 4, GF_TRUE },	/* BITMAPV3INFOHEADER */
+	{ 108, BMP_InfoFields, BMP_INFO_FIELDS + 3, 4, GF_TRUE },	/* BITMAPV4HEADER */
+	{ 124, BMP_InfoFields, BMP_INFO_FIELDS + 3, 4, GF_TRUE },	/* BITMAPV5HEADER */
+};
+
+
+/**************************************************************
+	Stores the fields of one table read from the file data into
+	the header. The caller has checked that they are all in it.
 **************************************************************/
-int	ReadHeader(const char* bmp_data, const int size )
+static void ReadHeaderFields( struct BMP_Header* header, const UCHAR* data, const struct BMP_HeaderField* fields, UINT nbFields )
 {
-	if ( bmp == NULL  )
+	UINT i;
+
+	for ( i = 0; i < nbFields; i++ )
 	{
-		return GF_NOT_SUPPORTED;
+		const struct BMP_HeaderField *f = &fields[ i ];
+		UINT x = ( f->Size == 4 ) ? BMP_LE32( data + f->Offset ) : BMP_LE16( data + f->Offset );
+
+		if ( f->FieldSize == sizeof( USHORT ) )
+			*(USHORT*) ( (UCHAR*) header + f->Field ) = (USHORT) x;
+		else
+			*(UINT*) ( (UCHAR*) header + f->Field ) = x;
 	}
+}
 
-	/* The header's fields are read one by one, and converted from the format's
-	little endian to the system's native representation. */
 
-	/* the first part is the general file header */
-	if ( !ReadUSHORT( &( bmp->Header.Magic ),bmp_data,size ) )			
+/**************************************************************
+	Reads the BMP file and DIB headers into the data structure.
+	The 12-byte core header and the 40, 52, 56, 108 and 124-byte
+	info headers are read from a table of their fields, after a
+	single check that the whole header is in the data.
+	Returns BMP_OK on success.
+**************************************************************/
+int	ReadHeader( struct BMP_struct* bmp, const char* bmp_data, const int size )
+{
+	const UCHAR *data = (const UCHAR *) bmp_data;
+	const struct BMP_HeaderVariant *v = NULL;
+	UINT i, headerEnd, nbFields, magic;
+
+	if ( bmp == NULL || size < 18 )
+	{
 		return GF_NOT_SUPPORTED;
+	}
 
-	
 	/* check the magic number options: BM, BA, CI, CP, IC, PT (little endian)*/
-	if (  bmp->Header.Magic != 0x4D42 && bmp->Header.Magic != 0x4D41 && bmp->Header.Magic != 0x4943 && bmp->Header.Magic != 0x5043 && bmp->Header.Magic != 0x5450)
+	magic = BMP_LE16( data );
+	if (  magic != 0x4D42 && magic != 0x4D41 && magic != 0x4943 && magic != 0x5043 && magic != 0x5450)
 	{
-		free( bmp );
 		return GF_NOT_SUPPORTED;
 	}
 
-	/* let's init this thing in case something squeaks by us - just do field-by-field*/
-	bmp->Header.FileSize = 0;
-	bmp->Header.Reserved1 = 0;
-	bmp->Header.Reserved2 = 0;
-	bmp->Header.DataOffset = 0;
-	bmp->Header.HeaderSize = 0;
-	bmp->Header.Width = 0;
-	bmp->Header.Height = 0;
-	bmp->Header.Planes = 0;
-	bmp->Header.BitsPerPixel = 0;
-	bmp->Header.CompressionType = 0;
-	bmp->Header.ImageDataSize = 0;
-	bmp->Header.HPixelsPerMeter = 0;
-	bmp->Header.VPixelsPerMeter = 0;
-	bmp->Header.ColorsUsed = 0;
-	bmp->Header.ColorsRequired = 0;
-	bmp->Header.Orientation = 0; /* indicates bottom-up bitmap, corresponds to positive Height value*/
-	bmp->Header.PaletteElementSize = 0; /* there are 3-byte or 4-byte palettes */
-	bmp->Header.PaletteSize = 0;
-	bmp->Header.BitMask = 0;
-	bmp->Header.RedMask.mask = 0;
+	/* the header and palette of the planned image are overwritten, the plan no longer applies
+	   until it is saved again for an image that decodes */
+	bmp->Plan.Valid = GF_FALSE;
+
+	/* fields absent from the header keep these values */
+	memset( &bmp->Header, 0, sizeof( struct BMP_Header ) );
 	bmp->Header.RedMask.range = 255;
-	bmp->Header.RedMask.lowBit = 0;
-	bmp->Header.GreenMask.mask = 0;
 	bmp->Header.GreenMask.range = 255;
-	bmp->Header.GreenMask.lowBit = 0;
-	bmp->Header.BlueMask.mask = 0;
 	bmp->Header.BlueMask.range = 255;
-	bmp->Header.BlueMask.lowBit = 0;
 
-	/* continue with general header */
-	if ( !ReadUINT( &( bmp->Header.FileSize ),bmp_data,size ) )			return GF_NOT_SUPPORTED;
-	if ( !ReadUSHORT( &( bmp->Header.Reserved1 ), bmp_data ,size) )		return GF_NOT_SUPPORTED;
-	if ( !ReadUSHORT( &( bmp->Header.Reserved2 ), bmp_data,size ) )		return GF_NOT_SUPPORTED;
-	if ( !ReadUINT( &( bmp->Header.DataOffset ), bmp_data,size ) )		return GF_NOT_SUPPORTED;
+	/* the first part is the general file header, with the size of the bitmap header */
+	ReadHeaderFields( &bmp->Header, data, BMP_FileFields, sizeof( BMP_FileFields ) / sizeof( BMP_FileFields[ 0 ] ) );
 
-	/* the second part is the bitmap header  */
-	if ( !ReadUINT( &( bmp->Header.HeaderSize ), bmp_data ,size) )		return GF_NOT_SUPPORTED;
-
-	/* sanity check first - we are expecting a 40 byte header for the demo cases */
-	if ( bmp->Header.HeaderSize != 40 	)
+	for ( i = 0; i < sizeof( BMP_HeaderVariants ) / sizeof( BMP_HeaderVariants[ 0 ] ); i++ )
+	{
+		if ( BMP_HeaderVariants[ i ].HeaderSize == bmp->Header.HeaderSize )
+			v = &BMP_HeaderVariants[ i ];
+	}
+	if ( v == NULL )
 	{
 		return GF_NOT_SUPPORTED;
 	}
 
-	/* Non-12-byte header cases*/
-	/* Common fields*/
-	if ( !ReadUINT( &( bmp->Header.Width ), bmp_data,size ) )			return GF_NOT_SUPPORTED;
-	if ( !ReadUINT( &( bmp->Header.Height ), bmp_data ,size) )			return GF_NOT_SUPPORTED;
-	if ( !ReadUSHORT( &( bmp->Header.Planes ), bmp_data,size ) )		return GF_NOT_SUPPORTED;
-	if ( !ReadUSHORT( &( bmp->Header.BitsPerPixel ), bmp_data ,size) )	return GF_NOT_SUPPORTED;
-	// Extract the orientation
-	if ((int)bmp->Header.Height < 0 ) bmp->Header.Orientation = 1; // MSB should indicate bitmap order
-		 bmp->Header.Height = (abs((int)bmp->Header.Height)) ;
-
-	/* read the other fields of the BITMAPINFOHEADER*/
-	if ( !ReadUINT( &( bmp->Header.CompressionType ), bmp_data ,size) )	return GF_NOT_SUPPORTED;
-	if ( !ReadUINT( &( bmp->Header.ImageDataSize ), bmp_data ,size) )	return GF_NOT_SUPPORTED;
-	if ( !ReadUINT( &( bmp->Header.HPixelsPerMeter ), bmp_data ,size) )	return GF_NOT_SUPPORTED;
-	if ( !ReadUINT( &( bmp->Header.VPixelsPerMeter ), bmp_data,size ) )	return GF_NOT_SUPPORTED;
-	if ( !ReadUINT( &( bmp->Header.ColorsUsed ), bmp_data,size ) )		return GF_NOT_SUPPORTED;
-	if ( !ReadUINT( &( bmp->Header.ColorsRequired ), bmp_data ,size) )	return GF_NOT_SUPPORTED;
+	headerEnd = 14 + v->HeaderSize;
+	nbFields = v->NbFields;
+	if ( headerEnd > (UINT) size )
+	{
+		return GF_NOT_SUPPORTED;
+	}
 
-	if (  bmp->Header.HeaderSize == 40) // Win Version 3s -  sanity check  and calculate the palette
+	/* BITFIELDS masks follow a 40-byte header, they are part of the later ones */
+	if ( v->HeaderSize == 40 && BMP_LE32( data + 30 ) == 3 )
 	{
-		// check the BBP and compression type for Win 3.x 
-		if ((bmp->Header.CompressionType < 0  ) || (bmp->Header.CompressionType > 3  ))
+		headerEnd += 12;
+		nbFields = BMP_INFO_FIELDS + 3;
+		if ( headerEnd > (UINT) size )
 		{
 			return GF_NOT_SUPPORTED;
 		}
-		if ((bmp->Header.BitsPerPixel != 1  ) && (bmp->Header.BitsPerPixel !=  4  ) &&  (bmp->Header.BitsPerPixel !=  8  ) && (bmp->Header.BitsPerPixel !=  24  )
-			 &&  (bmp->Header.BitsPerPixel !=  16  ) && (bmp->Header.BitsPerPixel !=  32  ))
+	}
+
+	/* the second part is the bitmap header */
+	ReadHeaderFields( &bmp->Header, data, v->Fields, nbFields );
+
+	// Extract the orientation
+	if ( v->Signed && (int)bmp->Header.Height < 0 )
+	{
+		/* the most negative height has no positive one, the others are negated on 32 bits */
+		if ( bmp->Header.Height == 0x80000000U )
 		{
 			return GF_NOT_SUPPORTED;
 		}
+		bmp->Header.Orientation = 1; // MSB should indicate bitmap order
+		bmp->Header.Height = 0U - (unsigned int) bmp->Header.Height;
+	}
 
-		/* calculate the palette */
-		bmp->Header.PaletteElementSize = 4; /* The Win 3.x format uses a 4-byte palette*/
-		bmp->Header.PaletteSize = (bmp->Header.DataOffset - 54); /* 14-byte header and 40-byte bitmap header */
-		/* Sanity check if needed - ImageDataSize can be 0 for uncompressed images */
-		if ((bmp->Header.CompressionType != 0) && (bmp->Header.ImageDataSize != bmp->Header.FileSize - bmp->Header.DataOffset))
-			{
-				return GF_NOT_SUPPORTED;
-			}
-		/* Otherwise allocate and read palette (color table), if present */
-		if (( bmp->Header.BitsPerPixel <= 8 ) && (bmp->Header.PaletteSize > 0) && (bmp->Header.BitMask == 0))
+	/* sanity check the BBP and compression type */
+	if ( bmp->Header.CompressionType > 3 )
+	{
+		return GF_NOT_SUPPORTED;
+	}
+	if ((bmp->Header.BitsPerPixel != 1  ) && (bmp->Header.BitsPerPixel !=  4  ) &&  (bmp->Header.BitsPerPixel !=  8  ) && (bmp->Header.BitsPerPixel !=  24  )
+		 &&  (bmp->Header.BitsPerPixel !=  16  ) && (bmp->Header.BitsPerPixel !=  32  ))
+	{
+		return GF_NOT_SUPPORTED;
+	}
+	/* Sanity check if needed - ImageDataSize can be 0 for uncompressed images */
+	if ((bmp->Header.CompressionType != 0) && (bmp->Header.ImageDataSize != bmp->Header.FileSize - bmp->Header.DataOffset))
+	{
+		return GF_NOT_SUPPORTED;
+	}
+	bmp->Header.BitMask = ( bmp->Header.CompressionType == 3 );
+
+	/* the palette (color table) fills the gap up to the pixel data */
+	if ( bmp->Header.DataOffset < headerEnd || bmp->Header.DataOffset - headerEnd > 0xFFFF )
+	{
+		return GF_NOT_SUPPORTED;
+	}
+	bmp->Header.PaletteElementSize = v->PaletteElementSize;
+	bmp->Header.PaletteSize = (USHORT) ( bmp->Header.DataOffset - headerEnd );
+	bmp->dataInd = headerEnd;
+
+	/* Otherwise allocate and read palette (color table), if present */
+	if (( bmp->Header.BitsPerPixel <= 8 ) && (bmp->Header.PaletteSize > 0) && (bmp->Header.BitMask == 0))
+		{
+			/* the palette buffer is reused from frame to frame, and only grows */
+			if ( bmp->PaletteAlloc < bmp->Header.PaletteSize )
 			{
-				bmp->Palette = (UCHAR*) malloc( bmp->Header.PaletteSize * sizeof( UCHAR ) );
+				BMP_Free( &bmp->Stats, bmp->Palette );
+				bmp->PaletteAlloc = 0;
+				bmp->Palette = (UCHAR*) BMP_Malloc( &bmp->Stats, bmp->Header.PaletteSize * sizeof( UCHAR ) );
 				if ( bmp->Palette == NULL )
 				{
-					free( bmp );
 					return GF_NOT_SUPPORTED;
 				}
+				bmp->PaletteAlloc = bmp->Header.PaletteSize;
+			}
 
-				if ( dataInd+ bmp->Header.PaletteSize > size )
-					{
-						free( bmp->Palette );
-						free( bmp );
-						return GF_NOT_SUPPORTED;
-					}
-				else
-					{
-						memcpy(bmp->Palette,bmp_data+dataInd, bmp->Header.PaletteSize);
-						dataInd += bmp->Header.PaletteSize;
-					}
+			if ( bmp->dataInd+ bmp->Header.PaletteSize > size )
+				{
+					return GF_NOT_SUPPORTED;
 				}
-		else	/* Not an indexed image */
-			{
-				bmp->Palette = NULL;
-			}	
-				
-	}   
+			else
+				{
+					memcpy(bmp->Palette,bmp_data+bmp->dataInd, bmp->Header.PaletteSize);
+					bmp->dataInd += bmp->Header.PaletteSize;
+				}
+			}
+	else	/* Not an indexed image */
+		{
+			bmp->Header.PaletteSize = 0;
+		}
 
 	return GF_OK;
 }
 
 
 /**************************************************************
-	Reads a little-endian unsigned int from the file.
-	Returns non-zero on success.
+	Gets the two colors of the image as RGB from the palette.
+	Without a palette (or with a truncated one) we fall back to
+	black on white.
 **************************************************************/
-int	ReadINT( int* x, const char* bmp_data,  const int size)
+void GetPaletteColors( const struct BMP_struct* bmp, UCHAR color[ 2 ][ 3 ] )
 {
-	UCHAR little[ 4 ];	/* BMPs use 32 bit ints */
+	int c;
 
-	if ( x == NULL || (dataInd + 4) > size )
+	/* default colors: 0 = black, 1 = white */
+	memset( color[ 0 ], 0, 3 );
+	memset( color[ 1 ], 255, 3 );
+
+	for ( c=0; c<2; ++c )
 	{
-		return 0;
+		if ( bmp->Palette && ( c+1 ) * bmp->Header.PaletteElementSize <= bmp->Header.PaletteSize )
+		{
+			/* palette entries are stored as B, G, R(, reserved) */
+			color[ c ][ 0 ] = *( bmp->Palette + c*bmp->Header.PaletteElementSize + 2 );
+			color[ c ][ 1 ] = *( bmp->Palette + c*bmp->Header.PaletteElementSize + 1 );
+			color[ c ][ 2 ] = *( bmp->Palette + c*bmp->Header.PaletteElementSize );
+		}
 	}
-
-	memcpy(&little[0],bmp_data+dataInd,4);
-	dataInd = dataInd+4;
-
-	*x = (int) ( little[ 3 ] << 24 | little[ 2 ] << 16 | little[ 1 ] << 8 | little[ 0 ] );
-
-	return 1;
 }
 
+
 /**************************************************************
-	Reads a little-endian unsigned int from the file.
-	Returns non-zero on success.
+	Returns the number of bytes per pixel of an output pixel
+	format, or 0 if the expansion kernels do not produce it. For
+	YUV formats this is the size of a luma sample.
 **************************************************************/
-int	ReadUINT( UINT* x, const char* bmp_data,  const int size)
+UINT GetPixelSize( u32 pixelFormat )
 {
-	UCHAR little[ 4 ];	/* BMPs use 32 bit ints */
-
-	if ( x == NULL || (dataInd + 4) > size )
+	switch ( pixelFormat )
 	{
-		return 0;
+	case GF_PIXEL_GREYSCALE:
+	case GF_PIXEL_YUV:
+	case GF_PIXEL_NV12:			return 1; /* luma plane */
+	case GF_PIXEL_RGB_565:		return 2;
+	case GF_PIXEL_RGB:
+	case GF_PIXEL_BGR:			return 3;
+	case GF_PIXEL_RGBA:
+	case GF_PIXEL_RGBX:			return 4;
+	default:					return 0;
 	}
+}
 
-	memcpy(&little[0],bmp_data+dataInd,4);
-	dataInd = dataInd+4;
 
-	*x = ( little[ 3 ] << 24 | little[ 2 ] << 16 | little[ 1 ] << 8 | little[ 0 ] );
+/**************************************************************
+	Returns the size of a whole output frame and the strides of
+	its planes. YUV formats carry 4:2:0 chroma after the luma
+	plane, planar for YUV and interleaved U/V for NV12. The size
+	is 64-bit, large images do not fit in a single packet.
+**************************************************************/
+u64 GetFrameLayout( u32 pixelFormat, UINT width, UINT height, UINT* stride, UINT* strideUV )
+{
+	u64 size;
+
+	*stride = width * GetPixelSize( pixelFormat );
+	*strideUV = 0;
+	size = (u64) *stride * height;
 
-	return 1;
+	if ( pixelFormat == GF_PIXEL_YUV || pixelFormat == GF_PIXEL_NV12 )
+	{
+		*strideUV = ( width + 1 ) / 2;
+		if ( pixelFormat == GF_PIXEL_NV12 )
+			*strideUV *= 2;
+		size += (u64) ( pixelFormat == GF_PIXEL_YUV ? 2 : 1 ) * *strideUV * ( ( height + 1 ) / 2 );
+	}
+	return size;
 }
 
 
 /**************************************************************
-	Reads a little-endian unsigned short int from the file.
-	Returns non-zero on success.
+	Writes one RGB color as a pixel of the given output format.
 **************************************************************/
-int	ReadUSHORT( USHORT *x, const char* bmp_data, const int size )
+static void FormatColor( u32 pixelFormat, const UCHAR rgb[ 3 ], UCHAR *out )
 {
-	UCHAR little[ 2 ];	/* BMPs use 16 bit shorts */
+	USHORT v;
 
-	if ( x == NULL || (dataInd + 2) > size )
+	switch ( pixelFormat )
 	{
-		return 0;
+	case GF_PIXEL_YUV:
+	case GF_PIXEL_NV12:
+		/* BT.601 video range luma */
+		out[ 0 ] = (UCHAR) ( ( ( 66*rgb[ 0 ] + 129*rgb[ 1 ] + 25*rgb[ 2 ] + 128 ) >> 8 ) + 16 );
+		break;
+	case GF_PIXEL_GREYSCALE:
+		/* BT.601 luma, 8-bit fixed point */
+		out[ 0 ] = (UCHAR) ( ( 77*rgb[ 0 ] + 150*rgb[ 1 ] + 29*rgb[ 2 ] + 128 ) >> 8 );
+		break;
+	case GF_PIXEL_RGB_565:
+		/* native little-endian 16-bit word */
+		v = (USHORT) ( ( ( rgb[ 0 ] & 0xF8 ) << 8 ) | ( ( rgb[ 1 ] & 0xFC ) << 3 ) | ( rgb[ 2 ] >> 3 ) );
+		out[ 0 ] = (UCHAR) ( v & 0xFF );
+		out[ 1 ] = (UCHAR) ( v >> 8 );
+		break;
+	case GF_PIXEL_BGR:
+		out[ 0 ] = rgb[ 2 ];
+		out[ 1 ] = rgb[ 1 ];
+		out[ 2 ] = rgb[ 0 ];
+		break;
+	case GF_PIXEL_RGBA:
+	case GF_PIXEL_RGBX:
+		memcpy( out, rgb, 3 );
+		out[ 3 ] = 255;
+		break;
+	default:
+		memcpy( out, rgb, 3 );
+		break;
 	}
+}
 
-	memcpy(&little[0],bmp_data+dataInd,2);
-	dataInd = dataInd+2;
 
+/**************************************************************
+	Classifies two output pixels of p bytes. The class is taken
+	once formatted, as the output format can change it: any two
+	colors give two greys as grey or YUV luma, while the alpha
+	byte of RGBA makes even black and white arbitrary.
+**************************************************************/
+static UINT ClassifyPalette( const UCHAR pixel[ 2 ][ 4*BMP_MAX_ZOOM ], UINT p )
+{
+	UINT c, i;
 
-	*x = ( little[ 1 ] << 8 | little[ 0 ] );
+	for ( c=0; c<2; ++c )
+		for ( i=1; i<p; ++i )
+			if ( pixel[ c ][ i ] != pixel[ c ][ 0 ] )
+				return BMP_PALETTE_ANY;
 
-	return 1;
+	if ( pixel[ 0 ][ 0 ] == 0x00 && pixel[ 1 ][ 0 ] == 0xFF )
+		return BMP_PALETTE_BLACK_WHITE;
+	if ( pixel[ 0 ][ 0 ] == 0xFF && pixel[ 1 ][ 0 ] == 0x00 )
+		return BMP_PALETTE_WHITE_BLACK;
+	return BMP_PALETTE_GREYS;
 }
 
 
-/* this is function that handles the 1BPP format decode */
-int dec1(const char* bmp_data)
+/**************************************************************
+	Builds the expansion tables from the two colors for the given
+	output pixel format. Each of the 256 LUT entries holds the 8
+	pixels a source byte expands to, high bit first. The SIMD
+	kernels use the color patterns and, for each output byte of
+	a 32-pixel group, the mask of its source bit and the index
+	of the source byte holding it. Palettes of a specialised
+	class do not need the LUT, it is only built for the others.
+**************************************************************/
+void BuildExpandLUT( struct BMP_Expand* ex, const UCHAR color[ 2 ][ 3 ], u32 pixelFormat, UINT zoom )
 {
+	UCHAR pixel[ 2 ][ 4*BMP_MAX_ZOOM ];
+	UCHAR *entry;
+	UINT i, k, c, p, n;
+	int chroma[ 2 ][ 2 ];
 
-	int i,j,k;
-	scanLinePadding = 0;
-	if (bmp->Header.CompressionType == 0) /* calculate only if uncompressed */
-		{						
-			scanLinePadding = ((bmp->Header.FileSize - bmp->Header.DataOffset)/bmp->Header.Height)*8 - bmp->Header.Width;
-		}
+	/* tables already built for the same colors, format and zoom are kept as they are */
+	if ( ex->PixelSize && ex->PixelFormat == pixelFormat && ex->Zoom == zoom && !memcmp( ex->Color, color, sizeof( ex->Color ) ) )
+		return;
 
-	if (bmp->Header.PaletteSize > 0)
+	/* a source pixel upscaled by zoom is written as zoom copies of the output pixel */
+	p = GetPixelSize( pixelFormat );
+	ex->PixelFormat = pixelFormat;
+	ex->PixelSize = p * zoom;
+	ex->Zoom = zoom;
+	ex->Scale = 1;
+	memcpy( ex->Color, color, sizeof( ex->Color ) );
+
+	for ( c=0; c<2; ++c )
+	{
+		FormatColor( pixelFormat, color[ c ], pixel[ c ] );
+		for ( k=1; k<zoom; ++k )
 		{
-					
-			UCHAR *tmp = bmp->Data;
-			UINT dataOffset = 0;
-			UCHAR paletteIndex = 0; 
-			UINT paletteInt = 0;
-
-			k=0; /* k will index bits 0=high, 7=low */
-			for (i=0; i<bmp->Header.Height; ++i)
-				{
-					for (j=0; j<bmp->Header.Width; ++j) /* we'll be grabbing a char at a time from the data */
-						{
-							if (k==0)
-								{
-									paletteIndex =  *(bmp_data+dataInd + dataOffset); // grab a char
-									++dataOffset;
-								}
-									
-								/* pull a bit from the char */
-								paletteInt=  ((paletteIndex & (1 << (7-k))) > 0) ? 1 : 0;
-										
-								*(tmp) = *(bmp->Palette+paletteInt*bmp->Header.PaletteElementSize+2); 
-								++tmp;  
-								*(tmp) = *(bmp->Palette+paletteInt*bmp->Header.PaletteElementSize+1); 
-								++tmp; 
-								*(tmp) = *(bmp->Palette+paletteInt*bmp->Header.PaletteElementSize); 
-								++tmp; 
-								/* only include an alpha if forcing RGBA out */
-								/*  *(tmp) = 255; ++tmp; */
-									k = (k+1)%8;
-						}
-					 	/* skip the rest of the padding, scanLinePadding is in nibbles */
-						if (scanLinePadding % 2 == 0)
-							{
-								dataOffset += (int) (scanLinePadding/8);
-							}
-						else
-							{
-								dataOffset += (int) (scanLinePadding -1)/8;
-							}
-						k=0; 
-				}
-					
-					
-					
-		}
-		else {  /* there might be a non-palette case - we do not have a device foreground/background so do black on white */
-				UCHAR *tmp = bmp->Data;
-				UINT dataOffset = 0;
-				int bitIdx;
-				for (i=0; i<bmp->Header.Height; ++i)
-					{
-						for (j=0; j<bmp->Header.Width; j+=8) /* we'll be grabbing a char at a time from the data */
-							{
-								bitIdx =  *(bmp_data+dataInd + dataOffset); // grab a char
-								/* broken out so we can step through colormap*/
-								for (k=0; k<8; ++k)
-									{ /*extract each bit from the char */
-										if ((bitIdx & (1 << (7-k))) > 0)
-											{
-												*(tmp) = 255; ++tmp;
-												*(tmp) = 255; ++tmp;
-												*(tmp) = 255; ++tmp;
-
-											} 
-											else
-												{
-												*(tmp) = 0; ++tmp;
-												*(tmp) = 0; ++tmp;
-												*(tmp) = 0; ++tmp;												
-												}
-											// took out the alpha
-											//*(tmp) = 255; ++tmp;
-										}
-									dataOffset +=1;
-							}
-					 	dataOffset += scanLinePadding;
-				 	}
+			memcpy( pixel[ c ] + k*p, pixel[ c ], p );
+		}
+	}
+	p = ex->PixelSize;
+
+	/* upscaled pixels only have LUT kernels */
+	ex->Palette = ( zoom == 1 ) ? ClassifyPalette( pixel, p ) : BMP_PALETTE_ANY;
+	ex->Grey[ 0 ] = 0x0101010101010101ULL * pixel[ 0 ][ 0 ];
+	ex->Grey[ 1 ] = 0x0101010101010101ULL * (UCHAR) ( pixel[ 0 ][ 0 ] ^ pixel[ 1 ][ 0 ] );
 
+	/* the SIMD kernels only exist for up to 4 bytes per source pixel */
+	if ( p <= 4 )
+	{
+		for ( c=0; c<2; ++c )
+		{
+			for ( k=0; k<32; ++k )
+			{
+				memcpy( ex->Pattern[ c ] + k*p, pixel[ c ], p );
 			}
-		
-	return GF_OK;
-}
+		}
 
+		for ( i=0; i<32*p; ++i )
+		{
+			ex->BitMask[ i ] = (UCHAR) ( 0x80 >> ( ( i / p ) % 8 ) );
+			ex->ByteIndex[ i ] = (UCHAR) ( i / p / 8 );
+		}
+	}
 
-typedef struct
-{
-	u32 opt1;
-	Bool opt2;
+	if ( pixelFormat == GF_PIXEL_YUV || pixelFormat == GF_PIXEL_NV12 )
+	{
+		/* BT.601 video range chroma of each color, scaled by 256 */
+		for ( c=0; c<2; ++c )
+		{
+			chroma[ 0 ][ c ] = -38*color[ c ][ 0 ] - 74*color[ c ][ 1 ] + 112*color[ c ][ 2 ];
+			chroma[ 1 ][ c ] = 112*color[ c ][ 0 ] - 94*color[ c ][ 1 ] - 18*color[ c ][ 2 ];
+		}
+		/* a block averages the chroma of its k pixels; the offset keeps the sum positive */
+		for ( c=0; c<2; ++c )
+			for ( k=1; k<=4; ++k )
+				for ( n=0; n<=k; ++n )
+					ex->Chroma[ c ][ k ][ n ] = (UCHAR) ( ( chroma[ c ][ 0 ]*(int)( k-n ) + chroma[ c ][ 1 ]*(int) n + 32896*(int) k ) / (int)( 256*k ) );
+	}
 
-	GF_FilterPid *src_pid;
-	GF_FilterPid *dst_pid;
-} GF_BaseFilter;
+	if ( ex->Palette != BMP_PALETTE_ANY )
+		return;
 
-static void base_filter_finalize(GF_Filter *filter)
-{
-	//peform any finalyze routine needed, including potential free in the filter context
-	//if not needed, set the filter_finalize to NULL
+	for ( i=0; i<256; ++i )
+	{
+		entry = ex->LUT + i*8*p;
+		for ( k=0; k<8; ++k ) /* k indexes bits 0=high, 7=low */
+		{
+			memcpy( entry + k*p, pixel[ ( i >> ( 7-k ) ) & 1 ], p );
+		}
+	}
+}
 
-	// no return needed return GF_OK;
 
+/**************************************************************
+	Writes the output pixel of a block of k pixels, n of them of
+	color 1: the two colors are mixed in proportion.
+**************************************************************/
+static void ShadePixel( const struct BMP_Expand* ex, UINT k, UINT n, UCHAR *out )
+{
+	UCHAR rgb[ 3 ];
+	UINT c;
+
+	for ( c=0; c<3; ++c )
+	{
+		rgb[ c ] = (UCHAR) ( ( ex->Color[ 0 ][ c ]*( k-n ) + ex->Color[ 1 ][ c ]*n + k/2 ) / k );
+	}
+	FormatColor( ex->PixelFormat, rgb, out );
 }
 
 
-static const char *BMP1BPP_probe_data(const u8 *data, u32 size, GF_FilterProbeScore *score)
+/**************************************************************
+	Builds the downscale tables of scale 2, 4 or 8 on top of the
+	expansion tables: the number of color-1 pixels in each block
+	a source byte covers, and the shades of whole blocks.
+**************************************************************/
+void BuildShadeLUT( struct BMP_Expand* ex, UINT scale )
 {
-	/*BMP*/
-	if ((data[0] == 'B') && (data[1] == 'M')) {
-		*score = GF_FPROBE_SUPPORTED;
-		return "image/bmp";
-	}
+	UINT i, l, n, bits, lanes = 8 / scale;
 
-	return NULL;
+	ex->Scale = scale;
+	for ( i=0; i<256; ++i )
+	{
+		ex->DownCount[ i ] = 0;
+		for ( l=0; l<lanes; ++l ) /* l indexes blocks, 0=leftmost in the high bits */
+		{
+			bits = ( i >> ( 8 - scale*( l+1 ) ) ) & ( ( 1 << scale ) - 1 );
+			for ( n=0; bits; bits &= bits-1 )
+				++n;
+			ex->DownCount[ i ] |= n << ( 8*( lanes-1-l ) );
+		}
+	}
+	for ( n=0; n<=scale*scale; ++n )
+	{
+		ShadePixel( ex, scale*scale, n, ex->Shade[ n ] );
+	}
 }
 
-static GF_Err BMP1BPP_filter_process(GF_Filter *filter)
+
+/**************************************************************
+	Builds the resample tables on top of the expansion tables:
+	the color-1 pixels of each source byte, and the shades of
+	the 256 coverage levels.
+**************************************************************/
+void BuildLevelLUT( struct BMP_Expand* ex )
 {
-	u8 *data_dst;
-	const u8 *data_src;
-	u32 size;
+	UINT i, n, bits;
 
+	for ( i=0; i<256; ++i )
+	{
+		for ( n=0, bits=i; bits; bits &= bits-1 )
+			++n;
+		ex->BitCount[ i ] = (UCHAR) n;
+		ShadePixel( ex, 255, i, ex->Level[ i ] );
+	}
+}
+
+
+/*********************************** Row expansion kernels **********************************/
+
+/* Kernels exist for each pixel size _P (1 to 4 bytes) and palette class _K and are
+   generated from the templates below. The output format only changes the tables
+   they read. _K is empty for any palette, or BW, WB or Grey, and picks how a mask
+   of the source bits (all 1 bits for color 1) becomes output bytes. */
+
+
+/**************************************************************
+	Scalar reference kernel: one table lookup and one copy of 8
+	pixels per source byte. Also used for the row tails of the
+	SIMD kernels.
+**************************************************************/
+#define BMP_SCALAR_KERNEL( _P ) \
+static void ExpandRow_Scalar_##_P( UCHAR *dst, const UCHAR *src, UINT width, const struct BMP_Expand *ex ) \
+{ \
+	UINT j; \
+	UINT fullBytes = width / 8; \
+	UINT tailBytes = ( width % 8 ) * _P; /* leftover pixels of the last, partial byte */ \
+	\
+	for ( j=0; j<fullBytes; ++j ) \
+	{ \
+		memcpy( dst, ex->LUT + src[ j ]*( 8*_P ), 8*_P ); \
+		dst += 8*_P; \
+	} \
+	\
+	/* widths that are not a multiple of 8 only use the high bits of the last byte */ \
+	if ( tailBytes ) \
+	{ \
+		memcpy( dst, ex->LUT + src[ fullBytes ]*( 8*_P ), tailBytes ); \
+	} \
+}
+
+BMP_SCALAR_KERNEL( 1 )
+BMP_SCALAR_KERNEL( 2 )
+BMP_SCALAR_KERNEL( 3 )
+BMP_SCALAR_KERNEL( 4 )
+/* upscaled rows, zoom times the pixel size */
+BMP_SCALAR_KERNEL( 6 )
+BMP_SCALAR_KERNEL( 8 )
+BMP_SCALAR_KERNEL( 9 )
+BMP_SCALAR_KERNEL( 12 )
+BMP_SCALAR_KERNEL( 16 )
+
+
+/* Palette-independent masks: the 8 pixels of each source byte with every byte of
+   a color-1 pixel at 0xFF, for each pixel size. Filled by InitKernelSets */
+static UCHAR BitMaskLUT[ 5 ][ 256*32 ];
+
+/* Output bytes of a word of mask, for each class */
+#define BMP_MASK_BW( _m, _ex )		( _m )
+#define BMP_MASK_WB( _m, _ex )		( ~( _m ) )
+#define BMP_MASK_Grey( _m, _ex )	( ( ( _m ) & ( _ex )->Grey[ 1 ] ) ^ ( _ex )->Grey[ 0 ] )
+
+/**************************************************************
+	Scalar kernel of a specialised palette class: the mask of
+	each source byte is turned into output bytes a word at a
+	time, no palette table is read.
+**************************************************************/
+#define BMP_SCALAR_MASK_KERNEL( _P, _K ) \
+static void ExpandRow_Scalar##_K##_##_P( UCHAR *dst, const UCHAR *src, UINT width, const struct BMP_Expand *ex ) \
+{ \
+	UINT j, k; \
+	UINT fullBytes = width / 8; \
+	UINT tailBytes = ( width % 8 ) * _P; /* leftover pixels of the last, partial byte */ \
+	u64 m, out[ _P ]; \
+	\
+	for ( j=0; j<fullBytes; ++j ) \
+	{ \
+		for ( k=0; k<_P; ++k ) \
+		{ \
+			memcpy( &m, BitMaskLUT[ _P ] + src[ j ]*( 8*_P ) + 8*k, 8 ); \
+			m = BMP_MASK_##_K( m, ex ); \
+			memcpy( dst + 8*k, &m, 8 ); \
+		} \
+		dst += 8*_P; \
+	} \
+	\
+	if ( tailBytes ) \
+	{ \
+		for ( k=0; k<_P; ++k ) \
+		{ \
+			memcpy( &m, BitMaskLUT[ _P ] + src[ fullBytes ]*( 8*_P ) + 8*k, 8 ); \
+			out[ k ] = BMP_MASK_##_K( m, ex ); \
+		} \
+		memcpy( dst, out, tailBytes ); \
+	} \
+}
+
+#define BMP_SCALAR_MASK_KERNELS( _K ) \
+BMP_SCALAR_MASK_KERNEL( 1, _K ) \
+BMP_SCALAR_MASK_KERNEL( 2, _K ) \
+BMP_SCALAR_MASK_KERNEL( 3, _K ) \
+BMP_SCALAR_MASK_KERNEL( 4, _K )
+
+BMP_SCALAR_MASK_KERNELS( BW )
+BMP_SCALAR_MASK_KERNELS( WB )
+BMP_SCALAR_MASK_KERNELS( Grey )
+
+
+/* The 128-bit kernels expand 2 source bytes (16 pixels, _P vectors) per iteration.
+   Output bytes [0, 8*_P) come from the first source byte and the rest from the
+   second one, so each vector tests either the first byte, the second one, or
+   (odd _P) the first byte in its low half and the second in its high half. */
+#define BMP_VECTOR_SOURCE( _v, _P, _first, _second, _mixed ) \
+	( ( 16*( (_v)+1 ) <= 8*(_P) ) ? (_first) : ( ( 16*(_v) >= 8*(_P) ) ? (_second) : (_mixed) ) )
+
+
+#ifdef BMP_HAS_SSE2
+/**************************************************************
+	SSE2 kernel: each output byte tests its own source bit, and
+	the resulting mask blends the two color patterns. For black
+	and white the mask is the output. Two greys blend like any
+	colors, only their row tails differ.
+**************************************************************/
+#define BMP_SSE2_SELECT( _s, _c, _d )		_mm_xor_si128( _c, _mm_and_si128( _s, _d ) )
+#define BMP_SSE2_SELECTBW( _s, _c, _d )		( (void) ( _c ), (void) ( _d ), ( _s ) )
+#define BMP_SSE2_SELECTGrey( _s, _c, _d )	BMP_SSE2_SELECT( _s, _c, _d )
+#define BMP_SSE2_SELECTWB( _s, _c, _d )		( (void) ( _d ), _mm_xor_si128( _c, _s ) )
+
+#define BMP_SSE2_KERNEL( _P, _K ) \
+static void ExpandRow_SSE2##_K##_##_P( UCHAR *dst, const UCHAR *src, UINT width, const struct BMP_Expand *ex ) \
+{ \
+	UINT j, v; \
+	UINT groups = width / 16; \
+	__m128i m[ _P ], c[ _P ], d[ _P ]; \
+	\
+	for ( v=0; v<_P; ++v ) \
+	{ \
+		m[ v ] = _mm_loadu_si128( (const __m128i *) ( ex->BitMask + 16*v ) ); \
+		c[ v ] = _mm_loadu_si128( (const __m128i *) ( ex->Pattern[ 0 ] + 16*v ) ); \
+		d[ v ] = _mm_xor_si128( c[ v ], _mm_loadu_si128( (const __m128i *) ( ex->Pattern[ 1 ] + 16*v ) ) ); \
+	} \
+	\
+	for ( j=0; j<groups; ++j ) \
+	{ \
+		/* widen the 2 source bytes to 8 copies each, then 16 */ \
+		__m128i mixed = _mm_cvtsi32_si128( src[ 0 ] | ( src[ 1 ] << 8 ) ); \
+		__m128i first, second; \
+		mixed = _mm_unpacklo_epi8( mixed, mixed ); \
+		mixed = _mm_unpacklo_epi16( mixed, mixed ); \
+		mixed = _mm_unpacklo_epi32( mixed, mixed ); \
+		first = _mm_unpacklo_epi64( mixed, mixed ); \
+		second = _mm_unpackhi_epi64( mixed, mixed ); \
+		\
+		for ( v=0; v<_P; ++v ) \
+		{ \
+			__m128i s = BMP_VECTOR_SOURCE( v, _P, first, second, mixed ); \
+			s = _mm_cmpeq_epi8( _mm_and_si128( s, m[ v ] ), m[ v ] ); \
+			_mm_storeu_si128( (__m128i *) ( dst + 16*v ), BMP_SSE2_SELECT##_K( s, c[ v ], d[ v ] ) ); \
+		} \
+		src += 2; \
+		dst += 16*_P; \
+	} \
+	\
+	ExpandRow_Scalar##_K##_##_P( dst, src, width - groups*16, ex ); \
+}
+
+#define BMP_SSE2_KERNELS( _K ) \
+BMP_SSE2_KERNEL( 1, _K ) \
+BMP_SSE2_KERNEL( 2, _K ) \
+BMP_SSE2_KERNEL( 3, _K ) \
+BMP_SSE2_KERNEL( 4, _K )
+
+BMP_SSE2_KERNELS( )
+BMP_SSE2_KERNELS( BW )
+BMP_SSE2_KERNELS( WB )
+BMP_SSE2_KERNELS( Grey )
+#endif
+
+
+#ifdef BMP_HAS_AVX2
+/**************************************************************
+	AVX2 kernel: 4 source bytes (32 pixels, _P vectors) per
+	iteration. The source word is broadcast and shuffled so that
+	each output byte sees the source byte holding its bit.
+**************************************************************/
+#define BMP_AVX2_SELECT( _s, _c, _d )		_mm256_xor_si256( _c, _mm256_and_si256( _s, _d ) )
+#define BMP_AVX2_SELECTBW( _s, _c, _d )		( (void) ( _c ), (void) ( _d ), ( _s ) )
+#define BMP_AVX2_SELECTGrey( _s, _c, _d )	BMP_AVX2_SELECT( _s, _c, _d )
+#define BMP_AVX2_SELECTWB( _s, _c, _d )		( (void) ( _d ), _mm256_xor_si256( _c, _s ) )
+
+#define BMP_AVX2_KERNEL( _P, _K ) \
+__attribute__(( target( "avx2" ) )) \
+static void ExpandRow_AVX2##_K##_##_P( UCHAR *dst, const UCHAR *src, UINT width, const struct BMP_Expand *ex ) \
+{ \
+	UINT j, v, word; \
+	UINT groups = width / 32; \
+	__m256i m[ _P ], idx[ _P ], c[ _P ], d[ _P ]; \
+	\
+	for ( v=0; v<_P; ++v ) \
+	{ \
+		m[ v ] = _mm256_loadu_si256( (const __m256i *) ( ex->BitMask + 32*v ) ); \
+		idx[ v ] = _mm256_loadu_si256( (const __m256i *) ( ex->ByteIndex + 32*v ) ); \
+		c[ v ] = _mm256_loadu_si256( (const __m256i *) ( ex->Pattern[ 0 ] + 32*v ) ); \
+		d[ v ] = _mm256_xor_si256( c[ v ], _mm256_loadu_si256( (const __m256i *) ( ex->Pattern[ 1 ] + 32*v ) ) ); \
+	} \
+	\
+	for ( j=0; j<groups; ++j ) \
+	{ \
+		__m256i w; \
+		memcpy( &word, src, 4 ); \
+		/* every 128-bit lane holds the 4 source bytes, so the in-lane shuffle can reach them all */ \
+		w = _mm256_set1_epi32( (int) word ); \
+		for ( v=0; v<_P; ++v ) \
+		{ \
+			__m256i s = _mm256_shuffle_epi8( w, idx[ v ] ); \
+			s = _mm256_cmpeq_epi8( _mm256_and_si256( s, m[ v ] ), m[ v ] ); \
+			_mm256_storeu_si256( (__m256i *) ( dst + 32*v ), BMP_AVX2_SELECT##_K( s, c[ v ], d[ v ] ) ); \
+		} \
+		src += 4; \
+		dst += 32*_P; \
+	} \
+	\
+	ExpandRow_Scalar##_K##_##_P( dst, src, width - groups*32, ex ); \
+}
+
+#define BMP_AVX2_KERNELS( _K ) \
+BMP_AVX2_KERNEL( 1, _K ) \
+BMP_AVX2_KERNEL( 2, _K ) \
+BMP_AVX2_KERNEL( 3, _K ) \
+BMP_AVX2_KERNEL( 4, _K )
+
+BMP_AVX2_KERNELS( )
+BMP_AVX2_KERNELS( BW )
+BMP_AVX2_KERNELS( WB )
+BMP_AVX2_KERNELS( Grey )
+#endif
+
+
+#ifdef BMP_HAS_NEON
+/**************************************************************
+	NEON kernel: same layout as the SSE2 one, the bit test and
+	select map to vtst/vbsl.
+**************************************************************/
+#define BMP_NEON_SELECT( _s, _c0, _c1 )		vbslq_u8( _s, _c1, _c0 )
+#define BMP_NEON_SELECTBW( _s, _c0, _c1 )	( (void) ( _c0 ), (void) ( _c1 ), ( _s ) )
+#define BMP_NEON_SELECTGrey( _s, _c0, _c1 )	BMP_NEON_SELECT( _s, _c0, _c1 )
+#define BMP_NEON_SELECTWB( _s, _c0, _c1 )	( (void) ( _c0 ), (void) ( _c1 ), vmvnq_u8( _s ) )
+
+#define BMP_NEON_KERNEL( _P, _K ) \
+static void ExpandRow_NEON##_K##_##_P( UCHAR *dst, const UCHAR *src, UINT width, const struct BMP_Expand *ex ) \
+{ \
+	UINT j, v; \
+	UINT groups = width / 16; \
+	uint8x16_t m[ _P ], c0[ _P ], c1[ _P ]; \
+	\
+	for ( v=0; v<_P; ++v ) \
+	{ \
+		m[ v ] = vld1q_u8( ex->BitMask + 16*v ); \
+		c0[ v ] = vld1q_u8( ex->Pattern[ 0 ] + 16*v ); \
+		c1[ v ] = vld1q_u8( ex->Pattern[ 1 ] + 16*v ); \
+	} \
+	\
+	for ( j=0; j<groups; ++j ) \
+	{ \
+		uint8x16_t first = vdupq_n_u8( src[ 0 ] ); \
+		uint8x16_t second = vdupq_n_u8( src[ 1 ] ); \
+		uint8x16_t mixed = vcombine_u8( vdup_n_u8( src[ 0 ] ), vdup_n_u8( src[ 1 ] ) ); \
+		\
+		for ( v=0; v<_P; ++v ) \
+		{ \
+			uint8x16_t s = vtstq_u8( BMP_VECTOR_SOURCE( v, _P, first, second, mixed ), m[ v ] ); \
+			vst1q_u8( dst + 16*v, BMP_NEON_SELECT##_K( s, c0[ v ], c1[ v ] ) ); \
+		} \
+		src += 2; \
+		dst += 16*_P; \
+	} \
+	\
+	ExpandRow_Scalar##_K##_##_P( dst, src, width - groups*16, ex ); \
+}
+
+#define BMP_NEON_KERNELS( _K ) \
+BMP_NEON_KERNEL( 1, _K ) \
+BMP_NEON_KERNEL( 2, _K ) \
+BMP_NEON_KERNEL( 3, _K ) \
+BMP_NEON_KERNEL( 4, _K )
+
+BMP_NEON_KERNELS( )
+BMP_NEON_KERNELS( BW )
+BMP_NEON_KERNELS( WB )
+BMP_NEON_KERNELS( Grey )
+#endif
+
+
+#ifdef BMP_HAS_SIMD128
+/**************************************************************
+	WebAssembly SIMD128 kernel: same layout as the SSE2 one.
+**************************************************************/
+#define BMP_SIMD128_SELECT( _s, _c0, _c1 )		wasm_v128_bitselect( _c1, _c0, _s )
+#define BMP_SIMD128_SELECTBW( _s, _c0, _c1 )	( (void) ( _c0 ), (void) ( _c1 ), ( _s ) )
+#define BMP_SIMD128_SELECTGrey( _s, _c0, _c1 )	BMP_SIMD128_SELECT( _s, _c0, _c1 )
+#define BMP_SIMD128_SELECTWB( _s, _c0, _c1 )	( (void) ( _c0 ), (void) ( _c1 ), wasm_v128_not( _s ) )
+
+#define BMP_SIMD128_KERNEL( _P, _K ) \
+static void ExpandRow_SIMD128##_K##_##_P( UCHAR *dst, const UCHAR *src, UINT width, const struct BMP_Expand *ex ) \
+{ \
+	UINT j, v; \
+	UINT groups = width / 16; \
+	v128_t m[ _P ], c0[ _P ], c1[ _P ]; \
+	\
+	for ( v=0; v<_P; ++v ) \
+	{ \
+		m[ v ] = wasm_v128_load( ex->BitMask + 16*v ); \
+		c0[ v ] = wasm_v128_load( ex->Pattern[ 0 ] + 16*v ); \
+		c1[ v ] = wasm_v128_load( ex->Pattern[ 1 ] + 16*v ); \
+	} \
+	\
+	for ( j=0; j<groups; ++j ) \
+	{ \
+		v128_t first = wasm_i8x16_splat( (signed char) src[ 0 ] ); \
+		v128_t second = wasm_i8x16_splat( (signed char) src[ 1 ] ); \
+		v128_t mixed = wasm_i8x16_shuffle( first, second, 0,1,2,3,4,5,6,7, 16,17,18,19,20,21,22,23 ); \
+		\
+		for ( v=0; v<_P; ++v ) \
+		{ \
+			v128_t s = BMP_VECTOR_SOURCE( v, _P, first, second, mixed ); \
+			s = wasm_i8x16_eq( wasm_v128_and( s, m[ v ] ), m[ v ] ); \
+			wasm_v128_store( dst + 16*v, BMP_SIMD128_SELECT##_K( s, c0[ v ], c1[ v ] ) ); \
+		} \
+		src += 2; \
+		dst += 16*_P; \
+	} \
+	\
+	ExpandRow_Scalar##_K##_##_P( dst, src, width - groups*16, ex ); \
+}
+
+#define BMP_SIMD128_KERNELS( _K ) \
+BMP_SIMD128_KERNEL( 1, _K ) \
+BMP_SIMD128_KERNEL( 2, _K ) \
+BMP_SIMD128_KERNEL( 3, _K ) \
+BMP_SIMD128_KERNEL( 4, _K )
+
+BMP_SIMD128_KERNELS( )
+BMP_SIMD128_KERNELS( BW )
+BMP_SIMD128_KERNELS( WB )
+BMP_SIMD128_KERNELS( Grey )
+#endif
+
+
+/* Row kernels the target supports, scalar first and widest last. Filled by InitKernelSets */
+struct BMP_KernelSet
+{
+	const char*		Name;
+	BMP_ExpandRow	Row[ BMP_NB_PALETTES ][ 5 ];
+};
+
+#define BMP_MAX_KERNEL_SETS	3
+
+static struct BMP_KernelSet KernelSets[ BMP_MAX_KERNEL_SETS ];
+static UINT NbKernelSets = 0;
+
+/* One-time fill of the sets, instances may be initialised from several threads at once:
+   the first caller fills the tables, the others block until it is done */
+static BMP_Once KernelSetsOnce = BMP_ONCE_INIT;
+
+/* Guards the kernel profile of the process, created along with the sets */
+static GF_Mutex *ProfileMutex = NULL;
+
+#define BMP_SET_KERNELS( _isa, _class, _K ) \
+	kernels[ _class ][ 1 ] = ExpandRow_##_isa##_K##_1; \
+	kernels[ _class ][ 2 ] = ExpandRow_##_isa##_K##_2; \
+	kernels[ _class ][ 3 ] = ExpandRow_##_isa##_K##_3; \
+	kernels[ _class ][ 4 ] = ExpandRow_##_isa##_K##_4;
+
+#define BMP_SET_ALL_KERNELS( _isa ) \
+	BMP_SET_KERNELS( _isa, BMP_PALETTE_ANY, ) \
+	BMP_SET_KERNELS( _isa, BMP_PALETTE_BLACK_WHITE, BW ) \
+	BMP_SET_KERNELS( _isa, BMP_PALETTE_WHITE_BLACK, WB ) \
+	BMP_SET_KERNELS( _isa, BMP_PALETTE_GREYS, Grey )
+
+#define BMP_ADD_KERNEL_SET( _isa, _name ) \
+	{ \
+		BMP_ExpandRow ( *kernels )[ 5 ] = sets[ n ].Row; \
+		sets[ n ].Name = _name; \
+		BMP_SET_ALL_KERNELS( _isa ) \
+		n++; \
+	}
+
+/**************************************************************
+	Lists the row kernel sets the target supports. Only the x86
+	AVX2 set depends on the running CPU, the others are fixed at
+	build time. Called once, through InitKernelSets.
+**************************************************************/
+static void FillKernelSets( void )
+{
+	struct BMP_KernelSet *sets = KernelSets;
+	UINT i, k, c, p, n = 0;
+
+	for ( p=1; p<=4; ++p )
+		for ( i=0; i<256; ++i )
+			for ( k=0; k<8; ++k ) /* k indexes bits 0=high, 7=low */
+				for ( c=0; c<p; ++c )
+					BitMaskLUT[ p ][ ( i*8 + k )*p + c ] = (UCHAR) ( ( ( i >> ( 7-k ) ) & 1 ) ? 0xFF : 0x00 );
+
+	BMP_ADD_KERNEL_SET( Scalar, "scalar" )
+#ifdef BMP_HAS_SSE2
+	BMP_ADD_KERNEL_SET( SSE2, "sse2" )
+#endif
+#ifdef BMP_HAS_AVX2
+	__builtin_cpu_init( );
+	if ( __builtin_cpu_supports( "avx2" ) )
+	{
+		BMP_ADD_KERNEL_SET( AVX2, "avx2" )
+	}
+#endif
+#ifdef BMP_HAS_NEON
+	BMP_ADD_KERNEL_SET( NEON, "neon" )
+#endif
+#ifdef BMP_HAS_SIMD128
+	BMP_ADD_KERNEL_SET( SIMD128, "simd128" )
+#endif
+
+	NbKernelSets = n;
+	ProfileMutex = gf_mx_new( "BMP1BPP profile" );
+}
+
+
+/**************************************************************
+	Fills the row kernel sets on the first call of the process.
+	Later and concurrent calls return once they are filled.
+**************************************************************/
+void InitKernelSets( )
+{
+	BMP_CALL_ONCE( KernelSetsOnce, FillKernelSets );
+}
+
+
+/**************************************************************
+	Fills the row kernels of an instance from the kernel set
+	chosen for each number of bytes per source pixel.
+**************************************************************/
+void SetExpandKernels( struct BMP_Kernels* kernels, const UINT kernelSet[ 5 ] )
+{
+	UINT c, p;
+
+	InitKernelSets( );
+
+	for ( c=0; c<BMP_NB_PALETTES; ++c )
+		for ( p=1; p<=4; ++p )
+			kernels->Row[ c ][ p ] = KernelSets[ kernelSet[ p ] ].Row[ c ][ p ];
+	/* upscaled pixels are wider than a SIMD lane group, they use table copies */
+	kernels->Row[ BMP_PALETTE_ANY ][ 6 ] = ExpandRow_Scalar_6;
+	kernels->Row[ BMP_PALETTE_ANY ][ 8 ] = ExpandRow_Scalar_8;
+	kernels->Row[ BMP_PALETTE_ANY ][ 9 ] = ExpandRow_Scalar_9;
+	kernels->Row[ BMP_PALETTE_ANY ][ 12 ] = ExpandRow_Scalar_12;
+	kernels->Row[ BMP_PALETTE_ANY ][ 16 ] = ExpandRow_Scalar_16;
+}
+
+
+/* Synthetic rows the kernels are timed on, and best-of passes */
+#define BMP_TUNE_WIDTH		1024
+#define BMP_TUNE_ROWS		128
+#define BMP_TUNE_DST_ROWS	8	/* rows written in turn, they stay in cache */
+#define BMP_TUNE_PASSES		3
+
+/* A palette of each class, as the kernels see it in RGB. The two greys are not
+   a grey class in 565, which then times the LUT kernels twice */
+static const UCHAR TunePalettes[ BMP_NB_PALETTES ][ 2 ][ 3 ] =
+{
+	{ { 10, 200, 30 }, { 250, 40, 90 } },
+	{ { 0, 0, 0 }, { 255, 255, 255 } },
+	{ { 255, 255, 255 }, { 0, 0, 0 } },
+	{ { 64, 64, 64 }, { 192, 192, 192 } },
+};
+
+/**************************************************************
+	Fills size bytes with pseudo-random source pixels, the same
+	on every run.
+**************************************************************/
+static void FillTuneRows( UCHAR* src, UINT size )
+{
+	u32 x = 0x2545F491;
+	UINT i;
+
+	for ( i=0; i<size; ++i )
+	{
+		x = x*1103515245 + 12345;
+		src[ i ] = (UCHAR) ( x >> 24 );
+	}
+}
+
+/**************************************************************
+	Times a kernel expanding the synthetic rows, in microseconds,
+	the best of a few passes.
+**************************************************************/
+static u64 TimeKernel( BMP_ExpandRow kernel, UCHAR* dst, const UCHAR* src, const struct BMP_Expand* ex )
+{
+	u64 best = (u64) -1, start, t;
+	UINT pass, i;
+
+	for ( pass=0; pass<BMP_TUNE_PASSES; ++pass )
+	{
+		start = gf_sys_clock_high_res( );
+		for ( i=0; i<BMP_TUNE_ROWS; ++i )
+			kernel( dst + ( i % BMP_TUNE_DST_ROWS )*BMP_TUNE_WIDTH*ex->PixelSize, src + i*BMP_TUNE_WIDTH/8, BMP_TUNE_WIDTH, ex );
+		t = gf_sys_clock_high_res( ) - start;
+		if ( t < best )
+			best = t;
+	}
+	return best;
+}
+
+/**************************************************************
+	Benchmarks every kernel set for each number of bytes per
+	source pixel, over a palette of each class, and keeps the
+	fastest in the profile. Returns GF_FALSE if the buffers
+	could not be allocated.
+**************************************************************/
+Bool TuneExpandKernels( struct BMP_Profile* profile, struct BMP_AllocStats* stats )
+{
+	static const u32 formats[ 5 ] = { 0, GF_PIXEL_GREYSCALE, GF_PIXEL_RGB_565, GF_PIXEL_RGB, GF_PIXEL_RGBX };
+	struct BMP_Expand *ex;
+	UCHAR *src, *dst;
+	u64 time, best;
+	UINT p, s, c;
+
+	InitKernelSets( );
+
+	/* source rows are read a bit past their end by the wider kernels */
+	ex = (struct BMP_Expand*) BMP_Calloc( stats, 1, sizeof( struct BMP_Expand ) );
+	src = (UCHAR*) BMP_Malloc( stats, BMP_TUNE_ROWS*BMP_TUNE_WIDTH/8 + 64 );
+	dst = (UCHAR*) BMP_Malloc( stats, BMP_TUNE_DST_ROWS*BMP_TUNE_WIDTH*4 + 64 );
+	if ( ex == NULL || src == NULL || dst == NULL )
+	{
+		BMP_Free( stats, ex );
+		BMP_Free( stats, src );
+		BMP_Free( stats, dst );
+		return GF_FALSE;
+	}
+	FillTuneRows( src, BMP_TUNE_ROWS*BMP_TUNE_WIDTH/8 + 64 );
+
+	for ( p=1; p<=4; ++p )
+	{
+		best = (u64) -1;
+		for ( s=0; s<NbKernelSets; ++s )
+		{
+			time = 0;
+			for ( c=0; c<BMP_NB_PALETTES; ++c )
+			{
+				BuildExpandLUT( ex, TunePalettes[ c ], formats[ p ], 1 );
+				time += TimeKernel( KernelSets[ s ].Row[ ex->Palette ][ p ], dst, src, ex );
+			}
+			/* a tie keeps the narrower set */
+			if ( time < best )
+			{
+				best = time;
+				profile->KernelSet[ p ] = s;
+			}
+		}
+	}
+	profile->Tuned = GF_TRUE;
+
+	BMP_Free( stats, ex );
+	BMP_Free( stats, src );
+	BMP_Free( stats, dst );
+	return GF_TRUE;
+}
+
+
+/*********************************** Row-band decode **********************************/
+
+
+/**************************************************************
+	Returns the source row holding output row i: bottom-up
+	bitmaps store the last image row first.
+**************************************************************/
+static const UCHAR *SourceRow( const struct BMP_DecodeJob *job, UINT i )
+{
+	if ( job->Orientation == 0 ) /* origin in lower-left */
+		i = job->SrcHeight-1-i;
+	return job->Src + i*job->SrcStride;
+}
+
+
+/**************************************************************
+	Writes one row of 4:2:0 chroma from the two source rows it
+	covers (b is NULL on the last row of an odd height). Each
+	chroma sample only depends on how many of its 2x2 pixels
+	are of color 1, counted with a pairwise popcount.
+**************************************************************/
+static void ChromaRow( const struct BMP_DecodeJob *job, const UCHAR *a, const UCHAR *b, UCHAR *u, UCHAR *v )
+{
+	const struct BMP_Expand *ex = job->Expand;
+	const UCHAR *tu, *tv;
+	UINT j, f, n, k, x;
+	UINT fullBytes = job->Width / 8;
+	UINT step = job->ChromaStep;
+	UINT rows = b ? 2 : 1;
+	UINT pa, pb = 0;
+
+	/* 4 full blocks per source byte */
+	tu = ex->Chroma[ 0 ][ 2*rows ];
+	tv = ex->Chroma[ 1 ][ 2*rows ];
+	for ( j=0; j<fullBytes; ++j )
+	{
+		pa = ( a[ j ] & 0x55 ) + ( ( a[ j ] >> 1 ) & 0x55 ); /* 4 pixel pair counts, 2 bits each */
+		if ( b )
+			pb = ( b[ j ] & 0x55 ) + ( ( b[ j ] >> 1 ) & 0x55 );
+		for ( f=0; f<4; ++f )
+		{
+			n = ( ( pa >> ( 6-2*f ) ) & 3 ) + ( ( pb >> ( 6-2*f ) ) & 3 );
+			*u = tu[ n ];
+			*v = tv[ n ];
+			u += step;
+			v += step;
+		}
+	}
+
+	/* blocks of the last, partial byte, the rightmost one may hold a single column */
+	for ( x=fullBytes*8; x<job->Width; x+=2 )
+	{
+		k = ( x+1 < job->Width ) ? 2 : 1;
+		n = 0;
+		for ( f=x; f<x+k; ++f )
+		{
+			n += ( a[ f/8 ] >> ( 7 - f%8 ) ) & 1;
+			if ( b )
+				n += ( b[ f/8 ] >> ( 7 - f%8 ) ) & 1;
+		}
+		*u = ex->Chroma[ 0 ][ k*rows ][ n ];
+		*v = ex->Chroma[ 1 ][ k*rows ][ n ];
+		u += step;
+		v += step;
+	}
+}
+
+
+/* Source words sampled to choose the run path for a row, and how many must be uniform */
+#define BMP_RUN_SAMPLES		8
+#define BMP_RUN_MIN_UNIFORM	4
+
+/**************************************************************
+	Reads the 64 source pixels of a word, as stored.
+**************************************************************/
+static u64 LoadWord( const UCHAR *src )
+{
+	u64 w;
+
+	memcpy( &w, src, sizeof( w ) );
+	return w;
+}
+
+
+/**************************************************************
+	Tells whether a source row of nbWords 8-byte words is worth
+	expanding by runs: samples a few words spread over the row
+	and checks that enough of them are all 0 or all 1 bits, so
+	that noisy rows keep the plain kernel at little cost.
+**************************************************************/
+static int RowHasRuns( const UCHAR *src, UINT nbWords )
+{
+	UINT k, uniform = 0;
+	u64 w;
+
+	if ( nbWords < BMP_RUN_SAMPLES )
+		return 0;
+	for ( k=0; k<BMP_RUN_SAMPLES; ++k )
+	{
+		w = LoadWord( src + 8*( k*nbWords / BMP_RUN_SAMPLES ) );
+		if ( w == 0 || w == ~(u64) 0 )
+			++uniform;
+	}
+	return uniform >= BMP_RUN_MIN_UNIFORM;
+}
+
+
+/**************************************************************
+	Fills nbPixels output pixels of size p with one color, from
+	its 32-pixel pattern then by doubling copies of what is
+	already written.
+**************************************************************/
+static void FillPixels( UCHAR *dst, const UCHAR *pattern, UINT p, UINT nbPixels )
+{
+	UINT done, n, size = nbPixels * p;
+
+	if ( p == 1 )
+	{
+		memset( dst, pattern[ 0 ], size );
+		return;
+	}
+	done = ( size < 32*p ) ? size : 32*p;
+	memcpy( dst, pattern, done );
+	while ( done < size )
+	{
+		n = ( size - done < done ) ? size - done : done;
+		memcpy( dst + done, dst, n );
+		done += n;
+	}
+}
+
+
+/**************************************************************
+	Expands a source row by runs: uniform 8-byte words are
+	merged into spans filled with bulk pattern stores, the
+	mixed words between them and the row tail go through the
+	row kernel.
+**************************************************************/
+static void ExpandRowRuns( const struct BMP_DecodeJob *job, UCHAR *dst, const UCHAR *src )
+{
+	const struct BMP_Expand *ex = job->Expand;
+	UINT p = ex->PixelSize;
+	UINT nbWords = job->SrcWidth / 64;
+	UINT j = 0, start, mixed = 0;
+	u64 w;
+
+	while ( j < nbWords )
+	{
+		w = LoadWord( src + 8*j );
+		if ( w != 0 && w != ~(u64) 0 )
+		{
+			++j;
+			continue;
+		}
+
+		if ( mixed < j )
+			job->Kernel( dst + mixed*64*p, src + 8*mixed, ( j-mixed )*64, ex );
+		for ( start=j++; j<nbWords && LoadWord( src + 8*j ) == w; ++j )
+			;
+		FillPixels( dst + start*64*p, ex->Pattern[ w ? 1 : 0 ], p, ( j-start )*64 );
+		mixed = j;
+	}
+
+	if ( mixed*64 < job->SrcWidth )
+		job->Kernel( dst + mixed*64*p, src + 8*mixed, job->SrcWidth - mixed*64, ex );
+}
+
+
+static void DecodeRows( const struct BMP_DecodeJob *job, UINT first, UINT last );
+
+/* Pixels per chunk of shifted source, a multiple of 32 */
+#define BMP_SHIFT_CHUNK		2048
+
+/**************************************************************
+	Copies nbBytes of a row starting shift bits into src, so that
+	they start on a byte boundary. avail is the number of bytes
+	of the row left from src on, bits past it read as 0.
+**************************************************************/
+static void ShiftRow( UCHAR *dst, const UCHAR *src, UINT shift, UINT nbBytes, UINT avail )
+{
+	UINT j;
+
+	for ( j=0; j<nbBytes; ++j )
+	{
+		dst[ j ] = (UCHAR) ( ( src[ j ] << shift ) | ( ( j+1 < avail ) ? ( src[ j+1 ] >> ( 8-shift ) ) : 0 ) );
+	}
+}
+
+
+/**************************************************************
+	Expands output rows [first, last) of a job whose columns do
+	not start on a byte boundary. Rows are realigned in chunks,
+	by pairs so that YUV chunks cover whole chroma blocks, and
+	each chunk is expanded as an aligned job of its own.
+**************************************************************/
+static void DecodeRowsShifted( const struct BMP_DecodeJob *job, UINT first, UINT last )
+{
+	UCHAR rows[ 2 ][ BMP_SHIFT_CHUNK/8 ];
+	struct BMP_DecodeJob part = *job;
+	const UCHAR *src;
+	UINT i, x, n, r, col, nbBytes;
+
+	part.SrcX = 0;
+	part.Src = rows[ 0 ];
+	part.SrcStride = BMP_SHIFT_CHUNK/8;
+	part.Orientation = 1;
+
+	for ( i=first; i<last; i+=n )
+	{
+		n = ( last - i < 2 ) ? 1 : 2;
+		for ( x=0; x<job->Width; x+=BMP_SHIFT_CHUNK )
+		{
+			part.Width = job->Width - x;
+			if ( part.Width > BMP_SHIFT_CHUNK )
+				part.Width = BMP_SHIFT_CHUNK;
+			part.SrcWidth = part.Width;
+			part.Height = part.SrcHeight = n;
+			col = job->SrcX + x;
+			nbBytes = ( part.Width + 7 ) / 8;
+			for ( r=0; r<n; ++r )
+			{
+				src = SourceRow( job, i+r ) + col/8;
+				ShiftRow( rows[ r ], src, col%8, nbBytes, job->SrcStride - col/8 );
+			}
+
+			part.Dst = job->Dst + i*job->DstStride + x*job->Expand->PixelSize;
+			if ( job->DstU != NULL )
+			{
+				part.DstU = job->DstU + ( i/2 )*job->ChromaStride + ( x/2 )*job->ChromaStep;
+				part.DstV = job->DstV + ( i/2 )*job->ChromaStride + ( x/2 )*job->ChromaStep;
+			}
+			DecodeRows( &part, 0, n );
+		}
+	}
+}
+
+
+/* Source bytes summed per pass of the downscale */
+#define BMP_DOWN_CHUNK		256
+
+/**************************************************************
+	Downscales source rows into output rows [first, last): each
+	output pixel is the shade of its Scale x Scale block, from
+	the count of color-1 pixels found by summing the per-byte
+	block counts of the block's rows. The full-size image is
+	never expanded.
+**************************************************************/
+static void DecodeRowsDown( const struct BMP_DecodeJob *job, UINT first, UINT last )
+{
+	const struct BMP_Expand *ex = job->Expand;
+	u32 acc[ BMP_DOWN_CHUNK ];
+	const UCHAR *row;
+	UCHAR *dst;
+	UINT i, r, j, l, x, n, k, bw, bh, cb, nb, fullBlocks;
+	UINT scale = job->Scale;
+	UINT lanes = 8 / scale;
+	UINT p = ex->PixelSize;
+	UINT srcBytes = ( job->SrcWidth + 7 ) / 8;
+	/* padding bits of the last byte must not count */
+	UCHAR lastMask = (UCHAR) ( ( job->SrcWidth % 8 ) ? 0xFF << ( 8 - job->SrcWidth % 8 ) : 0xFF );
+
+	for ( i=first; i<last; ++i )
+	{
+		bh = job->SrcHeight - i*scale;
+		if ( bh > scale )
+			bh = scale;
+		dst = job->Dst + i*job->DstStride;
+		/* pixels left of fullBlocks have whole blocks, and a precomputed shade */
+		fullBlocks = ( bh == scale ) ? job->SrcWidth / scale : 0;
+
+		for ( cb=0; cb<srcBytes; cb+=nb )
+		{
+			nb = srcBytes - cb;
+			if ( nb > BMP_DOWN_CHUNK )
+				nb = BMP_DOWN_CHUNK;
+
+			memset( acc, 0, nb * sizeof( u32 ) );
+			for ( r=0; r<bh; ++r )
+			{
+				row = SourceRow( job, i*scale + r ) + cb;
+				for ( j=0; j+1<nb; ++j )
+					acc[ j ] += ex->DownCount[ row[ j ] ];
+				acc[ j ] += ex->DownCount[ row[ j ] & ( cb+nb == srcBytes ? lastMask : 0xFF ) ];
+			}
+
+			for ( j=0; j<nb; ++j )
+			{
+				for ( l=0; l<lanes; ++l )
+				{
+					x = ( cb+j )*lanes + l;
+					n = ( acc[ j ] >> ( 8*( lanes-1-l ) ) ) & 0xFF;
+					if ( x < fullBlocks )
+					{
+						switch ( p ) /* constant-size copies */
+						{
+						case 1: dst[ x ] = ex->Shade[ n ][ 0 ]; break;
+						case 2: memcpy( dst + x*2, ex->Shade[ n ], 2 ); break;
+						case 3: memcpy( dst + x*3, ex->Shade[ n ], 3 ); break;
+						default: memcpy( dst + x*4, ex->Shade[ n ], 4 ); break;
+						}
+					}
+					else if ( x < job->Width )
+					{
+						bw = job->SrcWidth - x*scale;
+						k = ( bw < scale ? bw : scale ) * bh;
+						ShadePixel( ex, k, n, dst + x*p );
+					}
+				}
+			}
+		}
+	}
+}
+
+
+/* Output pixels resampled per pass */
+#define BMP_RESAMPLE_CHUNK	256
+
+/**************************************************************
+	Counts the color-1 pixels of source columns [from, to).
+**************************************************************/
+static UINT CountBits( const struct BMP_Expand *ex, const UCHAR *row, UINT from, UINT to )
+{
+	UINT n = 0, j = from / 8, end = to / 8;
+
+	if ( from >= to )
+		return 0;
+	if ( j == end ) /* within one byte */
+		return ex->BitCount[ row[ j ] & ( 0xFF >> ( from % 8 ) ) & (UCHAR) ~( 0xFF >> ( to % 8 ) ) ];
+
+	n = ex->BitCount[ row[ j ] & ( 0xFF >> ( from % 8 ) ) ];
+	for ( ++j; j<end; ++j )
+		n += ex->BitCount[ row[ j ] ];
+	if ( to % 8 )
+		n += ex->BitCount[ row[ end ] & (UCHAR) ~( 0xFF >> ( to % 8 ) ) ];
+	return n;
+}
+
+
+/**************************************************************
+	Resamples source rows into output rows [first, last) of any
+	size by area coverage. Source column x spans [x*Width,
+	(x+1)*Width) and output column o spans [o*SrcWidth,
+	(o+1)*SrcWidth) on a common axis, rows likewise: an output
+	pixel sums the overlaps of its color-1 source pixels, out of
+	SrcWidth*SrcHeight. Only bit counts of the packed rows are
+	read, the full-size image is never expanded.
+**************************************************************/
+static void DecodeRowsResample( const struct BMP_DecodeJob *job, UINT first, UINT last )
+{
+	const struct BMP_Expand *ex = job->Expand;
+	u64 acc[ BMP_RESAMPLE_CHUNK ];
+	UINT x0[ BMP_RESAMPLE_CHUNK ], x1[ BMP_RESAMPLE_CHUNK ];
+	UINT w0[ BMP_RESAMPLE_CHUNK ], w1[ BMP_RESAMPLE_CHUNK ];
+	const UCHAR *row;
+	UCHAR *dst;
+	UINT i, o, j, nb, y, y0, y1, wy, n;
+	u64 a, b, area = (u64) job->SrcWidth * job->SrcHeight;
+	UINT p = ex->PixelSize;
+
+	for ( i=first; i<last; ++i )
+	{
+		dst = job->Dst + i*job->DstStride;
+		a = (u64) i * job->SrcHeight;
+		b = a + job->SrcHeight;
+		y0 = (UINT) ( a / job->Height );
+		y1 = (UINT) ( ( b-1 ) / job->Height );
+
+		for ( o=0; o<job->Width; o+=nb )
+		{
+			nb = job->Width - o;
+			if ( nb > BMP_RESAMPLE_CHUNK )
+				nb = BMP_RESAMPLE_CHUNK;
+
+			/* first and last source columns of each output pixel, and how much of them it covers */
+			for ( j=0; j<nb; ++j )
+			{
+				a = (u64) ( o+j ) * job->SrcWidth;
+				b = a + job->SrcWidth;
+				x0[ j ] = (UINT) ( a / job->Width );
+				x1[ j ] = (UINT) ( ( b-1 ) / job->Width );
+				w0[ j ] = (UINT) ( (u64) ( x0[ j ]+1 ) * job->Width - a );
+				w1[ j ] = (UINT) ( b - (u64) x1[ j ] * job->Width );
+			}
+
+			memset( acc, 0, nb * sizeof( u64 ) );
+			for ( y=y0; y<=y1; ++y )
+			{
+				/* overlap of source row y with output row i */
+				if ( y0 == y1 )
+					wy = job->SrcHeight;
+				else if ( y == y0 )
+					wy = (UINT) ( (u64) ( y+1 ) * job->Height - (u64) i * job->SrcHeight );
+				else if ( y == y1 )
+					wy = (UINT) ( (u64) ( i+1 ) * job->SrcHeight - (u64) y * job->Height );
+				else
+					wy = job->Height;
+
+				row = SourceRow( job, y );
+				for ( j=0; j<nb; ++j )
+				{
+					if ( x0[ j ] == x1[ j ] )
+						n = ( ( row[ x0[ j ]/8 ] >> ( 7 - x0[ j ]%8 ) ) & 1 ) * job->SrcWidth;
+					else
+						n = ( ( row[ x0[ j ]/8 ] >> ( 7 - x0[ j ]%8 ) ) & 1 ) * w0[ j ]
+							+ CountBits( ex, row, x0[ j ]+1, x1[ j ] ) * job->Width
+							+ ( ( row[ x1[ j ]/8 ] >> ( 7 - x1[ j ]%8 ) ) & 1 ) * w1[ j ];
+					acc[ j ] += (u64) n * wy;
+				}
+			}
+
+			for ( j=0; j<nb; ++j )
+			{
+				n = (UINT) ( ( acc[ j ]*255 + area/2 ) / area );
+				memcpy( dst + ( o+j )*p, ex->Level[ n ], p );
+			}
+		}
+	}
+}
+
+
+/**************************************************************
+	Samples output rows [first, last) from one source pixel in
+	Step, in both directions: only one source row in Step is
+	read, for a quick preview.
+**************************************************************/
+static void DecodeRowsSampled( const struct BMP_DecodeJob *job, UINT first, UINT last )
+{
+	const struct BMP_Expand *ex = job->Expand;
+	const UCHAR *row, *color[ 2 ];
+	UCHAR *dst;
+	UINT i, x, sx;
+	UINT p = ex->PixelSize;
+
+	color[ 0 ] = ex->Pattern[ 0 ];
+	color[ 1 ] = ex->Pattern[ 1 ];
+
+	for ( i=first; i<last; ++i )
+	{
+		row = SourceRow( job, i*job->Step );
+		dst = job->Dst + i*job->DstStride;
+		for ( x=0, sx=0; x<job->Width; ++x, sx+=job->Step )
+		{
+			switch ( p ) /* constant-size copies */
+			{
+			case 1: dst[ x ] = color[ ( row[ sx/8 ] >> ( 7 - sx%8 ) ) & 1 ][ 0 ]; break;
+			case 2: memcpy( dst + x*2, color[ ( row[ sx/8 ] >> ( 7 - sx%8 ) ) & 1 ], 2 ); break;
+			case 3: memcpy( dst + x*3, color[ ( row[ sx/8 ] >> ( 7 - sx%8 ) ) & 1 ], 3 ); break;
+			default: memcpy( dst + x*4, color[ ( row[ sx/8 ] >> ( 7 - sx%8 ) ) & 1 ], 4 ); break;
+			}
+		}
+	}
+}
+
+
+/**************************************************************
+	Builds the pyramid rows that output row i of a job completes:
+	once the second row of a pair (or the last row) of a level is
+	written, the pair is averaged 2x2 into the next level, while
+	it is still in cache. Pixels are whole bytes per channel.
+**************************************************************/
+static void PyramidRow( const struct BMP_DecodeJob *job, UINT i )
+{
+	const UCHAR *a, *b;
+	UCHAR *dst;
+	UINT k, x, c, w, h, stride;
+	UINT p = job->Expand->PixelSize;
+	const UCHAR *src = job->Dst;
+
+	w = job->Width;
+	h = job->Height;
+	stride = job->DstStride;
+	for ( k=0; k<job->NbLevels; ++k )
+	{
+		if ( i % 2 == 0 && i+1 < h )
+			return;
+
+		/* a lone last row is paired with itself */
+		b = src + i*stride;
+		a = b - ( i % 2 )*stride;
+		dst = job->Levels[ k ].Dst + ( i/2 )*job->Levels[ k ].DstStride;
+		for ( x=0; x+1<w; x+=2 )
+		{
+			for ( c=0; c<p; ++c )
+				dst[ c ] = (UCHAR) ( ( a[ c ] + a[ p+c ] + b[ c ] + b[ p+c ] + 2 ) >> 2 );
+			a += 2*p;
+			b += 2*p;
+			dst += p;
+		}
+		if ( x < w )
+		{
+			for ( c=0; c<p; ++c )
+				dst[ c ] = (UCHAR) ( ( a[ c ] + b[ c ] + 1 ) >> 1 );
+		}
+
+		src = job->Levels[ k ].Dst;
+		stride = job->Levels[ k ].DstStride;
+		w = job->Levels[ k ].Width;
+		h = job->Levels[ k ].Height;
+		i /= 2;
+	}
+}
+
+
+/**************************************************************
+	Expands output rows [first, last) of a job. For YUV output
+	first is even, so that bands own whole chroma rows.
+**************************************************************/
+static void DecodeRows( const struct BMP_DecodeJob *job, UINT first, UINT last )
+{
+	const UCHAR *src;
+	UINT i, c;
+
+	if ( job->Scale > 1 )
+	{
+		DecodeRowsDown( job, first, last );
+		return;
+	}
+
+	if ( job->Resample )
+	{
+		DecodeRowsResample( job, first, last );
+		return;
+	}
+
+	if ( job->Step > 1 )
+	{
+		DecodeRowsSampled( job, first, last );
+		return;
+	}
+
+	if ( job->SrcX % 8 )
+	{
+		DecodeRowsShifted( job, first, last );
+		return;
+	}
+
+	if ( job->Zoom > 1 )
+	{
+		/* each source row gives Zoom identical output rows */
+		for ( i=first; i<last; ++i )
+		{
+			if ( i % job->Zoom && i > first )
+				memcpy( job->Dst + i*job->DstStride, job->Dst + ( i-1 )*job->DstStride, job->SrcWidth * job->Expand->PixelSize );
+			else
+				job->Kernel( job->Dst + i*job->DstStride, SourceRow( job, i / job->Zoom ), job->SrcWidth, job->Expand );
+		}
+		return;
+	}
+
+	for ( i=first; i<last; ++i )
+	{
+		/* mostly blank rows, as in scanned pages, are filled by runs */
+		src = SourceRow( job, i );
+		if ( RowHasRuns( src, job->SrcWidth / 64 ) )
+			ExpandRowRuns( job, job->Dst + i*job->DstStride, src );
+		else
+			job->Kernel( job->Dst + i*job->DstStride, src, job->SrcWidth, job->Expand );
+		if ( job->NbLevels )
+			PyramidRow( job, i );
+	}
+
+	if ( job->DstU == NULL )
+		return;
+
+	for ( i=first; i<last; i+=2 )
+	{
+		c = ( i/2 ) * job->ChromaStride;
+		ChromaRow( job, SourceRow( job, i ), ( i+1 < job->Height ) ? SourceRow( job, i+1 ) : NULL,
+			job->DstU + c, job->DstV + c );
+	}
+}
+
+
+/**************************************************************
+	Decodes bands of the current job until none is left.
+**************************************************************/
+static void WorkerPool_DecodeBands( struct BMP_WorkerPool *pool )
+{
+	const struct BMP_DecodeJob *job = pool->Job;
+	UINT band, first, last;
+
+	while ( 1 )
+	{
+		gf_mx_p( pool->Mutex );
+		band = pool->NextBand++;
+		gf_mx_v( pool->Mutex );
+
+		if ( pool->NbJobs )
+		{
+			if ( band >= pool->NbJobs )
+				break;
+			DecodeRows( &pool->Job[ band ], 0, pool->Job[ band ].Height );
+			continue;
+		}
+		if ( band >= job->NbBands )
+			break;
+
+		first = band * job->RowsPerBand;
+		last = first + job->RowsPerBand;
+		if ( last > job->Height )
+			last = job->Height;
+		DecodeRows( job, first, last );
+	}
+}
+
+
+static u32 WorkerPool_Thread( void *par )
+{
+	struct BMP_WorkerPool *pool = (struct BMP_WorkerPool *) par;
+
+	while ( 1 )
+	{
+		gf_sema_wait( pool->Start );
+		if ( pool->Exit )
+			break;
+
+		WorkerPool_DecodeBands( pool );
+		gf_sema_notify( pool->Done, 1 );
+	}
+	return 0;
+}
+
+
+/**************************************************************
+	Destroys the pool, waiting for its threads to exit.
+**************************************************************/
+static void WorkerPool_Del( struct BMP_WorkerPool *pool )
+{
+	UINT i;
+
+	if ( pool == NULL )
+		return;
+
+	pool->Exit = GF_TRUE;
+	gf_sema_notify( pool->Start, pool->NbThreads );
+	for ( i=0; i<pool->NbThreads; ++i )
+	{
+		gf_th_del( pool->Threads[ i ] );
+	}
+	BMP_Free( pool->Stats, pool->Threads );
+	gf_sema_del( pool->Start );
+	gf_sema_del( pool->Done );
+	gf_mx_del( pool->Mutex );
+	gf_mx_del( pool->JobMutex );
+	BMP_Free( pool->Stats, pool );
+}
+
+
+/**************************************************************
+	Creates a pool of nbThreads decode threads. Returns NULL if
+	no thread could be started (e.g. threads disabled in this
+	build), in which case decoding stays on the calling thread.
+**************************************************************/
+static struct BMP_WorkerPool *WorkerPool_New( UINT nbThreads, UINT minBandPixels, struct BMP_AllocStats *stats )
+{
+	struct BMP_WorkerPool *pool;
+	GF_Thread *th;
+
+	if ( nbThreads == 0 )
+		return NULL;
+
+	pool = (struct BMP_WorkerPool *) BMP_Calloc( stats, 1, sizeof( struct BMP_WorkerPool ) );
+	if ( pool == NULL )
+		return NULL;
+
+	pool->Stats = stats;
+	pool->MinBandPixels = minBandPixels ? minBandPixels : 1;
+	pool->Threads = (GF_Thread **) BMP_Calloc( stats, nbThreads, sizeof( GF_Thread * ) );
+	pool->Mutex = gf_mx_new( "BMP1BPP pool" );
+	pool->JobMutex = gf_mx_new( "BMP1BPP pool job" );
+	pool->Start = gf_sema_new( nbThreads, 0 );
+	pool->Done = gf_sema_new( nbThreads, 0 );
+	if ( !pool->Threads || !pool->Mutex || !pool->JobMutex || !pool->Start || !pool->Done )
+	{
+		WorkerPool_Del( pool );
+		return NULL;
+	}
+
+	while ( pool->NbThreads < nbThreads )
+	{
+		th = gf_th_new( "BMP1BPP worker" );
+		if ( th == NULL )
+			break;
+		if ( gf_th_run( th, WorkerPool_Thread, pool ) != GF_OK )
+		{
+			gf_th_del( th );
+			break;
+		}
+		pool->Threads[ pool->NbThreads++ ] = th;
+	}
+
+	if ( pool->NbThreads == 0 )
+	{
+		WorkerPool_Del( pool );
+		return NULL;
+	}
+	return pool;
+}
+
+
+/**************************************************************
+	Splits a job in bands for the pool. Returns the number of
+	workers to start, 0 when the calling thread decodes it alone
+	because there is no pool or the image is too small to split.
+**************************************************************/
+static UINT WorkerPool_Plan( struct BMP_WorkerPool *pool, struct BMP_DecodeJob *job )
+{
+	UINT nbWorkers, maxBands, minRows;
+
+	if ( pool == NULL || job->Width == 0 )
+		return 0;
+
+	/* bands never go below the minimum size, and a few bands per thread keep the load balanced */
+	minRows = ( pool->MinBandPixels + job->Width - 1 ) / job->Width;
+	if ( job->Scale > 1 ) /* an output row reads Scale source rows */
+		minRows = ( minRows + job->Scale*job->Scale - 1 ) / ( job->Scale*job->Scale );
+	else if ( job->Resample && job->SrcHeight > job->Height ) /* likewise, about SrcHeight/Height source rows */
+		minRows = (UINT) ( ( (u64) minRows * job->Height + job->SrcHeight - 1 ) / job->SrcHeight );
+	maxBands = ( pool->NbThreads + 1 ) * 4;
+	job->RowsPerBand = ( job->Height + maxBands - 1 ) / maxBands;
+	if ( job->RowsPerBand < minRows )
+		job->RowsPerBand = minRows;
+	if ( job->DstU != NULL )
+		job->RowsPerBand += job->RowsPerBand & 1; /* chroma rows cover 2 rows */
+	if ( job->NbLevels ) /* the rows of every level of a band only come from the band */
+		job->RowsPerBand = ( ( job->RowsPerBand + ( 1 << job->NbLevels ) - 1 ) >> job->NbLevels ) << job->NbLevels;
+	job->NbBands = ( job->Height + job->RowsPerBand - 1 ) / job->RowsPerBand;
+
+	if ( job->NbBands <= 1 )
+		return 0;
+
+	nbWorkers = job->NbBands - 1;
+	if ( nbWorkers > pool->NbThreads )
+		nbWorkers = pool->NbThreads;
+	return nbWorkers;
+}
+
+
+/**************************************************************
+	Decodes the bands of a planned job with nbWorkers threads of
+	the pool and the calling thread. JobMutex must be held.
+**************************************************************/
+static void WorkerPool_Dispatch( struct BMP_WorkerPool *pool, struct BMP_DecodeJob *job, UINT nbWorkers )
+{
+	UINT i;
+
+	pool->Job = job;
+	pool->NextBand = 0;
+	gf_sema_notify( pool->Start, nbWorkers );
+	WorkerPool_DecodeBands( pool );
+	for ( i=0; i<nbWorkers; ++i )
+	{
+		gf_sema_wait( pool->Done );
+	}
+	pool->Job = NULL;
+}
+
+
+/**************************************************************
+	Runs a job on the pool, or on the calling thread alone when
+	there is no pool or the image is too small to be split.
+**************************************************************/
+static void WorkerPool_Run( struct BMP_WorkerPool *pool, struct BMP_DecodeJob *job )
+{
+	UINT nbWorkers = WorkerPool_Plan( pool, job );
+
+	if ( nbWorkers == 0 )
+	{
+		DecodeRows( job, 0, job->Height );
+		return;
+	}
+
+	gf_mx_p( pool->JobMutex );
+	WorkerPool_Dispatch( pool, job, nbWorkers );
+	gf_mx_v( pool->JobMutex );
+}
+
+
+/**************************************************************
+	Runs a job on the pool if no other job is, otherwise on the
+	calling thread alone. Lazy frames read by several consumers
+	at once are then expanded side by side, not one after the
+	other.
+**************************************************************/
+static void WorkerPool_RunIfIdle( struct BMP_WorkerPool *pool, struct BMP_DecodeJob *job )
+{
+	UINT nbWorkers = WorkerPool_Plan( pool, job );
+
+	if ( nbWorkers == 0 || !gf_mx_try_lock( pool->JobMutex ) )
+	{
+		DecodeRows( job, 0, job->Height );
+		return;
+	}
+
+	WorkerPool_Dispatch( pool, job, nbWorkers );
+	gf_mx_v( pool->JobMutex );
+}
+
+
+/**************************************************************
+	Runs independent jobs on the pool, e.g. the tiles of a row
+	of tiles, each job being decoded whole by one thread.
+**************************************************************/
+static void WorkerPool_RunBatch( struct BMP_WorkerPool *pool, struct BMP_DecodeJob *jobs, UINT nbJobs )
+{
+	UINT nbWorkers, i;
+
+	if ( pool == NULL || nbJobs <= 1 )
+	{
+		for ( i=0; i<nbJobs; ++i )
+			WorkerPool_Run( pool, &jobs[ i ] );
+		return;
+	}
+
+	nbWorkers = nbJobs - 1;
+	if ( nbWorkers > pool->NbThreads )
+		nbWorkers = pool->NbThreads;
+
+	gf_mx_p( pool->JobMutex );
+	pool->Job = jobs;
+	pool->NbJobs = nbJobs;
+	pool->NextBand = 0;
+	gf_sema_notify( pool->Start, nbWorkers );
+	WorkerPool_DecodeBands( pool );
+	for ( i=0; i<nbWorkers; ++i )
+	{
+		gf_sema_wait( pool->Done );
+	}
+	pool->Job = NULL;
+	pool->NbJobs = 0;
+	gf_mx_v( pool->JobMutex );
+}
+
+
+/*********************************** Output frame pool **********************************/
+
+
+/**************************************************************
+	Sets up an empty pool holding at most maxBuffers frames.
+	maxBuffers 0 disables recycling.
+**************************************************************/
+static void FramePool_Init( struct BMP_FramePool *pool, u32 maxBuffers, struct BMP_AllocStats *stats )
+{
+	memset( pool, 0, sizeof( struct BMP_FramePool ) );
+	pool->Stats = stats;
+	pool->MaxBuffers = maxBuffers;
+	if ( maxBuffers )
+	{
+		pool->Mutex = gf_mx_new( "BMP1BPP frames" );
+		if ( pool->Mutex == NULL )
+			pool->MaxBuffers = 0;
+	}
+}
+
+
+/**************************************************************
+	Returns a frame buffer of exactly size bytes, reusing a free
+	one when possible. When the pool is full, a free buffer of
+	another size is dropped to make room. Returns NULL when all
+	buffers are in flight or on allocation failure, in which
+	case the caller allocates the frame the regular way.
+**************************************************************/
+static UCHAR *FramePool_Get( struct BMP_FramePool *pool, u32 size )
+{
+	struct BMP_FrameBuffer *buf, *prev = NULL;
+
+	if ( pool->MaxBuffers == 0 )
+		return NULL;
+
+	gf_mx_p( pool->Mutex );
+	for ( buf = pool->Free; buf != NULL; prev = buf, buf = buf->Next )
+	{
+		if ( buf->Size == size )
+		{
+			if ( prev ) prev->Next = buf->Next;
+			else pool->Free = buf->Next;
+			gf_mx_v( pool->Mutex );
+			return (UCHAR *) buf + BMP_FRAME_HEADER;
+		}
+	}
+
+	if ( pool->NbBuffers >= pool->MaxBuffers )
+	{
+		if ( pool->Free == NULL )
+		{
+			gf_mx_v( pool->Mutex );
+			return NULL;
+		}
+		/* geometry changed, drop a stale buffer */
+		buf = pool->Free;
+		pool->Free = buf->Next;
+		pool->NbBuffers--;
+		BMP_Free( pool->Stats, buf );
+	}
+	pool->NbBuffers++;
+	gf_mx_v( pool->Mutex );
+
+	buf = (struct BMP_FrameBuffer *) BMP_Malloc( pool->Stats, BMP_FRAME_HEADER + size );
+	if ( buf == NULL )
+	{
+		gf_mx_p( pool->Mutex );
+		pool->NbBuffers--;
+		gf_mx_v( pool->Mutex );
+		return NULL;
+	}
+	buf->Next = NULL;
+	buf->Size = size;
+	return (UCHAR *) buf + BMP_FRAME_HEADER;
+}
+
+
+/**************************************************************
+	Gives a buffer from FramePool_Get back to the pool. Safe to
+	call from any thread.
+**************************************************************/
+static void FramePool_Put( struct BMP_FramePool *pool, UCHAR *data )
+{
+	struct BMP_FrameBuffer *buf = (struct BMP_FrameBuffer *) ( data - BMP_FRAME_HEADER );
+
+	gf_mx_p( pool->Mutex );
+	buf->Next = pool->Free;
+	pool->Free = buf;
+	gf_mx_v( pool->Mutex );
+}
+
+
+/**************************************************************
+	Releases the free buffers and the pool mutex. All frames are
+	expected to be back, GPAC keeps the filter alive until its
+	shared packets are released.
+**************************************************************/
+static void FramePool_Reset( struct BMP_FramePool *pool )
+{
+	struct BMP_FrameBuffer *buf;
+
+	while ( pool->Free != NULL )
+	{
+		buf = pool->Free;
+		pool->Free = buf->Next;
+		pool->NbBuffers--;
+		BMP_Free( pool->Stats, buf );
+	}
+	if ( pool->Mutex )
+		gf_mx_del( pool->Mutex );
+	pool->Mutex = NULL;
+	pool->MaxBuffers = 0;
+}
+
+
+/**************************************************************
+	Describes the decode of the image whose header was just read:
+	source rows, geometry and orientation. The destination,
+	expansion tables and row kernel are left to the caller.
+	Returns GF_NON_COMPLIANT_BITSTREAM if the pixel data does
+	not fit in the size bytes of the file.
+**************************************************************/
+int SetupDecodeJob( struct BMP_struct* bmp, const char* bmp_data, const int size, struct BMP_DecodeJob* job )
+{
+	bmp->scanLinePadding = 0;
+	/* an empty image has no rows to size, and nothing to decode */
+	if ( bmp->Header.Width == 0 || bmp->Header.Height == 0 )
+		return GF_NON_COMPLIANT_BITSTREAM;
+	if (bmp->Header.CompressionType == 0) /* calculate only if uncompressed */
+		{						
+			bmp->scanLinePadding = ((bmp->Header.FileSize - bmp->Header.DataOffset)/bmp->Header.Height)*8 - bmp->Header.Width;
+		}
+
+	memset( job, 0, sizeof( struct BMP_DecodeJob ) );
+	job->Src = (const UCHAR *) bmp_data + bmp->dataInd;
+	/* scanLinePadding is in bits, rows are always a whole number of bytes */
+	job->SrcStride = ( bmp->Header.Width + bmp->scanLinePadding ) / 8;
+	job->Width = job->SrcWidth = bmp->Header.Width;
+	job->Height = job->SrcHeight = bmp->Header.Height;
+	job->Scale = 1;
+	job->Zoom = 1;
+	job->Step = 1;
+	job->Orientation = bmp->Header.Orientation;
+
+	/* one check for the whole image, rows are then read unchecked */
+	if ( job->SrcStride == 0 || job->SrcStride < ( job->Width + 7 ) / 8 )
+		return GF_NON_COMPLIANT_BITSTREAM;
+	if ( (u64) bmp->dataInd + (u64) job->SrcStride * job->Height > (u64) size )
+		return GF_NON_COMPLIANT_BITSTREAM;
+
+	return GF_OK;
+}
+
+
+/**************************************************************
+	Sets up the decode of an image from the plan of the previous
+	one when its header and palette bytes are the same: nothing
+	is parsed or validated again, only the size of the pixel
+	data is checked. Returns 0 when the plan does not apply and
+	the header must be read.
+**************************************************************/
+int UseDecodePlan( struct BMP_struct* bmp, const char* bmp_data, const int size, struct BMP_DecodeJob* job )
+{
+	struct BMP_Plan *plan = &bmp->Plan;
+
+	if ( !plan->Valid || size < 0 || (UINT) size < plan->HeadSize )
+		return 0;
+	if ( memcmp( bmp_data, plan->Head, plan->HeadSize ) )
+		return 0;
+	if ( (u64) plan->dataInd + (u64) plan->Job.SrcStride * plan->Job.SrcHeight > (u64) size )
+		return 0;
+
+	bmp->Header = plan->Header;
+	bmp->dataInd = plan->dataInd;
+	bmp->scanLinePadding = plan->scanLinePadding;
+	*job = plan->Job;
+	job->Src = (const UCHAR *) bmp_data + plan->dataInd;
+	return 1;
+}
+
+
+/**************************************************************
+	Keeps the decode set up for the image just read as the plan
+	of the next ones. The plan is dropped if it cannot be kept.
+**************************************************************/
+void SaveDecodePlan( struct BMP_struct* bmp, const char* bmp_data, const struct BMP_DecodeJob* job )
+{
+	struct BMP_Plan *plan = &bmp->Plan;
+	UINT headSize = (UINT) bmp->dataInd;
+
+	plan->Valid = GF_FALSE;
+	if ( plan->HeadAlloc < headSize )
+	{
+		BMP_Free( &bmp->Stats, plan->Head );
+		plan->HeadAlloc = 0;
+		plan->Head = (UCHAR*) BMP_Malloc( &bmp->Stats, headSize );
+		if ( plan->Head == NULL )
+			return;
+		plan->HeadAlloc = headSize;
+	}
+
+	memcpy( plan->Head, bmp_data, headSize );
+	plan->HeadSize = headSize;
+	plan->Header = bmp->Header;
+	plan->dataInd = bmp->dataInd;
+	plan->scanLinePadding = bmp->scanLinePadding;
+	plan->Job = *job;
+	plan->Job.Src = NULL;
+	plan->Valid = GF_TRUE;
+}
+
+
+/**************************************************************
+	Points a job at its output frame and expansion tables. The
+	chroma planes of YUV formats follow the luma plane.
+**************************************************************/
+static void SetJobOutput( struct BMP_DecodeJob* job, const struct BMP_Expand* ex, UCHAR* dst, UINT dstStride )
+{
+	UINT stride, strideUV;
+
+	GetFrameLayout( ex->PixelFormat, job->Width, job->Height, &stride, &strideUV );
+
+	job->Dst = dst;
+	job->DstStride = dstStride;
+	job->Expand = ex;
+	job->Kernel = ex->Kernels->Row[ ex->Palette ][ ex->PixelSize ];
+	job->DstU = job->DstV = NULL;
+	job->ChromaStride = strideUV;
+	job->ChromaStep = 1;
+
+	if ( ex->PixelFormat == GF_PIXEL_YUV )
+	{
+		job->DstU = dst + dstStride * job->Height;
+		job->DstV = job->DstU + strideUV * ( ( job->Height + 1 ) / 2 );
+	}
+	else if ( ex->PixelFormat == GF_PIXEL_NV12 )
+	{
+		job->DstU = dst + dstStride * job->Height;
+		job->DstV = job->DstU + 1;
+		job->ChromaStep = 2;
+	}
+}
+
+
+/**************************************************************
+	Makes a job output the image downscaled by scale (2, 4 or
+	8), partial blocks on the right and bottom edges giving one
+	more pixel.
+**************************************************************/
+static void ScaleJob( struct BMP_DecodeJob* job, UINT scale )
+{
+	job->Scale = scale;
+	job->Width = ( job->SrcWidth + scale - 1 ) / scale;
+	job->Height = ( job->SrcHeight + scale - 1 ) / scale;
+}
+
+
+/**************************************************************
+	Makes a job output the image upscaled by zoom (2 to
+	BMP_MAX_ZOOM), each source pixel giving a zoom x zoom block.
+**************************************************************/
+static void ZoomJob( struct BMP_DecodeJob* job, UINT zoom )
+{
+	job->Zoom = zoom;
+	job->Width = job->SrcWidth * zoom;
+	job->Height = job->SrcHeight * zoom;
+}
+
+
+/**************************************************************
+	Makes a job output a preview of the image, sampled every
+	step pixels (rounded up).
+**************************************************************/
+static void SampleJob( struct BMP_DecodeJob* job, UINT step )
+{
+	job->Step = step;
+	job->Width = ( job->SrcWidth + step - 1 ) / step;
+	job->Height = ( job->SrcHeight + step - 1 ) / step;
+}
+
+
+/**************************************************************
+	Makes a job output the image resampled to any width x height
+	by area coverage.
+**************************************************************/
+static void ResampleJob( struct BMP_DecodeJob* job, UINT width, UINT height )
+{
+	job->Resample = 1;
+	job->Width = width;
+	job->Height = height;
+}
+
+
+/**************************************************************
+	Restricts a job to its output rows [first, first+nbRows),
+	e.g. to decode a strip of the image on its own.
+**************************************************************/
+static void SliceJob( const struct BMP_DecodeJob* job, UINT first, UINT nbRows, struct BMP_DecodeJob* slice )
+{
+	*slice = *job;
+	slice->Height = slice->SrcHeight = nbRows;
+	if ( job->Orientation == 0 ) /* the slice's last output row comes first in the file */
+		slice->Src = job->Src + ( job->Height - first - nbRows ) * job->SrcStride;
+	else
+		slice->Src = job->Src + first * job->SrcStride;
+}
+
+
+/**************************************************************
+	Restricts a job to the tile of width x height pixels whose
+	top-left corner is at column x, output row y. Tiles not
+	starting on a byte boundary are realigned while decoding.
+**************************************************************/
+static void TileJob( const struct BMP_DecodeJob* job, UINT x, UINT y, UINT width, UINT height, struct BMP_DecodeJob* tile )
+{
+	SliceJob( job, y, height, tile );
+	tile->Width = tile->SrcWidth = width;
+	if ( x % 8 )
+		tile->SrcX = x;
+	else
+		tile->Src += x / 8;
+}
+
+
+/* A band of rows is made to decode in this many times the cost of handing it to a thread */
+#define BMP_BAND_DISPATCH_RATIO	8
+
+/**************************************************************
+	Measures the cost of spreading a job over the pool against
+	the cost of expanding a pixel with the given kernels, and
+	returns the minimum pixels of a band. Returns 0 if it could
+	not be measured.
+**************************************************************/
+static UINT WorkerPool_Tune( struct BMP_WorkerPool *pool, const struct BMP_Kernels *kernels, struct BMP_AllocStats *stats )
+{
+	struct BMP_DecodeJob job, tiny;
+	struct BMP_Expand *ex;
+	UCHAR *src, *dst;
+	UINT minBandPixels, pass;
+	u64 start, t, decode = (u64) -1, dispatch = (u64) -1, pixels = 0;
+
+	ex = (struct BMP_Expand*) BMP_Calloc( stats, 1, sizeof( struct BMP_Expand ) );
+	src = (UCHAR*) BMP_Malloc( stats, BMP_TUNE_ROWS*BMP_TUNE_WIDTH/8 + 64 );
+	dst = (UCHAR*) BMP_Malloc( stats, BMP_TUNE_ROWS*BMP_TUNE_WIDTH*3 + 64 );
+	if ( ex != NULL && src != NULL && dst != NULL )
+	{
+		FillTuneRows( src, BMP_TUNE_ROWS*BMP_TUNE_WIDTH/8 + 64 );
+		ex->Kernels = kernels;
+		BuildExpandLUT( ex, TunePalettes[ BMP_PALETTE_ANY ], GF_PIXEL_RGB, 1 );
+
+		memset( &job, 0, sizeof( job ) );
+		job.Src = src;
+		job.SrcStride = BMP_TUNE_WIDTH/8;
+		job.Width = job.SrcWidth = BMP_TUNE_WIDTH;
+		job.Height = job.SrcHeight = BMP_TUNE_ROWS;
+		job.Scale = job.Zoom = job.Step = 1;
+		job.Orientation = 1;
+		SetJobOutput( &job, ex, dst, BMP_TUNE_WIDTH*3 );
+
+		/* one row per thread, so the time is all in waking the threads up and waiting for them */
+		SliceJob( &job, 0, pool->NbThreads + 1, &tiny );
+		tiny.Width = tiny.SrcWidth = 8;
+
+		minBandPixels = pool->MinBandPixels;
+		pool->MinBandPixels = 1;
+		for ( pass=0; pass<BMP_TUNE_PASSES; ++pass )
+		{
+			start = gf_sys_clock_high_res( );
+			DecodeRows( &job, 0, job.Height );
+			t = gf_sys_clock_high_res( ) - start;
+			if ( t < decode )
+				decode = t;
+
+			start = gf_sys_clock_high_res( );
+			WorkerPool_Run( pool, &tiny );
+			t = gf_sys_clock_high_res( ) - start;
+			if ( t < dispatch )
+				dispatch = t;
+		}
+		pool->MinBandPixels = minBandPixels;
+
+		if ( decode )
+		{
+			pixels = BMP_BAND_DISPATCH_RATIO * ( dispatch ? dispatch : 1 ) * BMP_TUNE_ROWS*BMP_TUNE_WIDTH / decode;
+			if ( pixels < BMP_TUNE_WIDTH )
+				pixels = BMP_TUNE_WIDTH;
+			if ( pixels > ( 1 << 24 ) )
+				pixels = 1 << 24;
+		}
+	}
+
+	BMP_Free( stats, ex );
+	BMP_Free( stats, src );
+	BMP_Free( stats, dst );
+	return (UINT) pixels;
+}
+
+
+/**************************************************************
+	This is function that handles the 1BPP format decode.
+	Each source row of the job is expanded to pixelFormat straight
+	into its final row of dst, in bands spread over the worker pool if
+	there is one.
+**************************************************************/
+int dec1( struct BMP_struct* bmp, struct BMP_DecodeJob* job, u32 pixelFormat, UCHAR* dst, UINT dstStride, struct BMP_WorkerPool* pool)
+{
+	UCHAR color[ 2 ][ 3 ];
+
+	if ( GetPixelSize( pixelFormat ) == 0 )
+		return GF_NOT_SUPPORTED;
+
+	GetPaletteColors( bmp, color );
+	BuildExpandLUT( &bmp->Expand, color, pixelFormat, job->Zoom );
+	if ( job->Scale > 1 )
+		BuildShadeLUT( &bmp->Expand, job->Scale );
+	if ( job->Resample )
+		BuildLevelLUT( &bmp->Expand );
+
+	SetJobOutput( job, &bmp->Expand, dst, dstStride );
+
+	WorkerPool_Run( pool, job );
+		
+	return GF_OK;
+}
+
+
+typedef struct
+{
+	//options
+	u32 pfmt;
+	u32 threads;
+	u32 bandpix;
+	u32 kernel;
+	Bool retune;
+	u32 nbframes;
+	Bool lazy;
+	Bool packed;
+	Bool stream;
+	u32 strip;
+	GF_PropVec2i tile;
+	GF_PropStringList roi;
+	u32 downscale;
+	u32 upscale;
+	GF_PropVec2i osize;
+	u32 pyramid;
+	u32 preview;
+
+	GF_FilterPid *src_pid;
+	GF_FilterPid *dst_pid;
+
+	struct BMP_struct bmp;
+	struct BMP_WorkerPool *pool;
+	//reference counts of the lazy tables, dropped from whichever thread releases a frame
+	GF_Mutex *lazy_mutex;
+	struct _bmp1bpp_lazy_tables *lazy_tables;
+	struct BMP_FramePool frames;
+	struct BMP_Stream unframed;
+	struct BMP_Rect *rois;
+	u32 nb_rois;
+	//pyramid levels, declared with the output; those the last image did not use are at end of stream
+	GF_FilterPid *level_pids[BMP_MAX_LEVELS];
+	Bool level_eos[BMP_MAX_LEVELS];
+	u32 nb_level_pids;
+} GF_BaseFilter;
+
+/* Expansion tables shared by the lazy frames of one palette, format and scaling,
+   built when the first of them is read */
+typedef struct _bmp1bpp_lazy_tables
+{
+	//held while the tables are built
+	GF_Mutex *mutex;
+	//the instance while they are current, and each frame using them
+	u32 ref_count;
+	Bool built;
+	UCHAR color[2][3];
+	u32 pfmt;
+	UINT zoom, scale, resample;
+	struct BMP_Expand expand;
+} BMP1BPP_LazyTables;
+
+static void BMP1BPP_lazy_tables_unref(GF_BaseFilter *stack, BMP1BPP_LazyTables *lt)
+{
+	u32 refs;
+
+	if (!lt) return;
+	gf_mx_p(stack->lazy_mutex);
+	refs = --lt->ref_count;
+	gf_mx_v(stack->lazy_mutex);
+	if (refs) return;
+	gf_mx_del(lt->mutex);
+	BMP_Free(&stack->bmp.Stats, lt);
+}
+
+/* Tables for a lazy frame of job: the current ones if they match, else new ones that become current */
+static BMP1BPP_LazyTables *BMP1BPP_lazy_tables_get(GF_BaseFilter *stack, const struct BMP_DecodeJob *job)
+{
+	BMP1BPP_LazyTables *lt = stack->lazy_tables;
+	UCHAR color[2][3];
+
+	GetPaletteColors(&stack->bmp, color);
+	if (lt && lt->pfmt == stack->pfmt && lt->zoom == job->Zoom && lt->scale == job->Scale && lt->resample == job->Resample
+		&& !memcmp(lt->color, color, sizeof(lt->color))) {
+		gf_mx_p(stack->lazy_mutex);
+		lt->ref_count++;
+		gf_mx_v(stack->lazy_mutex);
+		return lt;
+	}
+
+	lt = (BMP1BPP_LazyTables *) BMP_Calloc(&stack->bmp.Stats, 1, sizeof(BMP1BPP_LazyTables));
+	if (!lt) return NULL;
+	lt->mutex = gf_mx_new("BMP1BPP lazy tables");
+	memcpy(lt->color, color, sizeof(lt->color));
+	lt->pfmt = stack->pfmt;
+	lt->zoom = job->Zoom;
+	lt->scale = job->Scale;
+	lt->resample = job->Resample;
+	lt->ref_count = 2;
+	BMP1BPP_lazy_tables_unref(stack, stack->lazy_tables);
+	stack->lazy_tables = lt;
+	return lt;
+}
+
+static void base_filter_finalize(GF_Filter *filter)
+{
+	GF_BaseFilter *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
+
+	WorkerPool_Del(stack->pool);
+	stack->pool = NULL;
+	BMP1BPP_lazy_tables_unref(stack, stack->lazy_tables);
+	stack->lazy_tables = NULL;
+	if (stack->lazy_mutex)
+		gf_mx_del(stack->lazy_mutex);
+	stack->lazy_mutex = NULL;
+
+	if (stack->unframed.Frame)
+		gf_filter_pck_discard(stack->unframed.Frame);
+	stack->unframed.Frame = NULL;
+	BMP_Free(&stack->bmp.Stats, stack->unframed.Head);
+	BMP_Free(&stack->bmp.Stats, stack->unframed.Carry);
+	memset(&stack->unframed, 0, sizeof(stack->unframed));
+
+	FramePool_Reset(&stack->frames);
+
+	BMP_Free(&stack->bmp.Stats, stack->rois);
+	stack->rois = NULL;
+	stack->nb_rois = 0;
+
+	BMP_Free(&stack->bmp.Stats, stack->bmp.Palette);
+	stack->bmp.Palette = NULL;
+	stack->bmp.PaletteAlloc = 0;
+
+	BMP_Free(&stack->bmp.Stats, stack->bmp.Plan.Head);
+	memset(&stack->bmp.Plan, 0, sizeof(stack->bmp.Plan));
+
+	if (stack->bmp.Stats.LiveAllocs) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] %u blocks (" LLU " bytes) still allocated at finalize\n", stack->bmp.Stats.LiveAllocs, stack->bmp.Stats.LiveBytes));
+	} else {
+		GF_LOG(GF_LOG_DEBUG, GF_LOG_CODEC, ("[BMP1BPP] no memory left allocated, " LLU " allocations over the instance lifetime\n", stack->bmp.Stats.TotalAllocs));
+	}
+	if (stack->bmp.Stats.Mutex)
+		gf_mx_del(stack->bmp.Stats.Mutex);
+	stack->bmp.Stats.Mutex = NULL;
+}
+
+
+static const char *BMP1BPP_probe_data(const u8 *data, u32 size, GF_FilterProbeScore *score)
+{
+	/*BMP*/
+	if ((data[0] == 'B') && (data[1] == 'M')) {
+		*score = GF_FPROBE_SUPPORTED;
+		return "image/bmp";
+	}
+
+	return NULL;
+}
+
+/* Destructor of packets backed by the frame pool: the buffer goes back to the pool */
+static void BMP1BPP_frame_release(GF_Filter *filter, GF_FilterPid *pid, GF_FilterPacket *pck)
+{
+	u32 size;
+	GF_BaseFilter *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
+	const u8 *data = gf_filter_pck_get_data(pck, &size);
+
+	if (data)
+		FramePool_Put(&stack->frames, (UCHAR *) data);
+}
+
+/* Pixel format of the packed output: 1 bit per pixel, 8 pixels per byte, not a GPAC pixel format */
+#define BMP_PIXEL_PACKED1	GF_4CC('B','P','K','1')
+
+/* Frame expanded on first access, see the lazy option */
+typedef struct
+{
+	GF_FilterFrameInterface ifce;
+	GF_BaseFilter *stack;
+	//input packet holding the source bits, kept until the frame is released
+	GF_FilterPacket *src_pck;
+	struct BMP_DecodeJob job;
+	BMP1BPP_LazyTables *tables;
+	u32 pfmt;
+	//first expansion, which several consumer threads may ask for at once
+	GF_Mutex *mutex;
+	//expanded frame, NULL until a consumer asks for it
+	UCHAR *data;
+	Bool pooled;
+} BMP1BPP_LazyFrame;
+
+static GF_Err BMP1BPP_lazy_get_plane(GF_FilterFrameInterface *frame, u32 plane_idx, const u8 **outPlane, u32 *outStride)
+{
+	BMP1BPP_LazyFrame *lf = (BMP1BPP_LazyFrame *) frame->user_data;
+	GF_BaseFilter *stack = lf->stack;
+
+	UINT stride, stride_uv;
+	u32 frame_size;
+
+	frame_size = (u32) GetFrameLayout(lf->pfmt, lf->job.Width, lf->job.Height, &stride, &stride_uv);
+	if (plane_idx > (u32) (lf->pfmt == GF_PIXEL_YUV ? 2 : (lf->pfmt == GF_PIXEL_NV12 ? 1 : 0)))
+		return GF_BAD_PARAM;
+
+	//the first reader expands the frame, the others wait for it and then share it
+	gf_mx_p(lf->mutex);
+	if (!lf->data) {
+		BMP1BPP_LazyTables *lt = lf->tables;
+		UCHAR *data = FramePool_Get(&stack->frames, frame_size);
+		Bool pooled = data ? GF_TRUE : GF_FALSE;
+		if (!data)
+			data = (UCHAR *) BMP_Malloc(&stack->bmp.Stats, frame_size);
+		if (!data) {
+			gf_mx_v(lf->mutex);
+			return GF_OUT_OF_MEM;
+		}
+
+		//the tables are only built once a frame using them is read, then kept for the others
+		gf_mx_p(lt->mutex);
+		if (!lt->built) {
+			lt->expand.Kernels = &stack->bmp.Kernels;
+			BuildExpandLUT(&lt->expand, lt->color, lt->pfmt, lt->zoom);
+			if (lt->scale > 1)
+				BuildShadeLUT(&lt->expand, lt->scale);
+			if (lt->resample)
+				BuildLevelLUT(&lt->expand);
+			lt->built = GF_TRUE;
+		}
+		gf_mx_v(lt->mutex);
+
+		SetJobOutput(&lf->job, &lt->expand, data, stride);
+		WorkerPool_RunIfIdle(stack->pool, &lf->job);
+
+		lf->pooled = pooled;
+		lf->data = data;
+	}
+	gf_mx_v(lf->mutex);
+	if (plane_idx == 0) {
+		*outPlane = lf->data;
+		*outStride = lf->job.DstStride;
+	} else {
+		*outPlane = (plane_idx == 1) ? lf->job.DstU : lf->job.DstV;
+		*outStride = lf->job.ChromaStride;
+	}
+	return GF_OK;
+}
+
+static void BMP1BPP_lazy_release(GF_Filter *filter, GF_FilterPid *pid, GF_FilterPacket *pck)
+{
+	GF_FilterFrameInterface *frame = gf_filter_pck_get_frame_interface(pck);
+	BMP1BPP_LazyFrame *lf = frame ? (BMP1BPP_LazyFrame *) frame->user_data : NULL;
+	GF_BaseFilter *stack;
+
+	if (!lf) return;
+	stack = lf->stack;
+	if (lf->data) {
+		if (lf->pooled) FramePool_Put(&stack->frames, lf->data);
+		else BMP_Free(&stack->bmp.Stats, lf->data);
+	}
+	gf_mx_del(lf->mutex);
+	BMP1BPP_lazy_tables_unref(stack, lf->tables);
+	gf_filter_pck_unref(lf->src_pck);
+	BMP_Free(&stack->bmp.Stats, lf);
+}
+
+/* Creates a frame that only references the source bits, expansion happens in get_plane */
+static GF_Err BMP1BPP_send_lazy_packet(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job, GF_FilterPacket **out)
+{
+	GF_FilterPacket *pck_dst;
+	struct BMP_struct *bmp = &stack->bmp;
+	BMP1BPP_LazyFrame *lf = (BMP1BPP_LazyFrame *) BMP_Calloc(&bmp->Stats, 1, sizeof(BMP1BPP_LazyFrame));
+	if (!lf) return GF_OUT_OF_MEM;
+
+	lf->stack = stack;
+	lf->ifce.get_plane = BMP1BPP_lazy_get_plane;
+	lf->ifce.user_data = lf;
+	lf->job = *job;
+	lf->pfmt = stack->pfmt;
+	lf->tables = BMP1BPP_lazy_tables_get(stack, job);
+	lf->mutex = gf_mx_new("BMP1BPP lazy frame");
+
+	pck_dst = lf->tables ? gf_filter_pck_new_frame_interface(stack->dst_pid, &lf->ifce, BMP1BPP_lazy_release) : NULL;
+	if (!pck_dst) {
+		gf_mx_del(lf->mutex);
+		BMP1BPP_lazy_tables_unref(stack, lf->tables);
+		BMP_Free(&bmp->Stats, lf);
+		return GF_OUT_OF_MEM;
+	}
+	lf->src_pck = pck;
+	gf_filter_pck_ref(&lf->src_pck);
+	*out = pck_dst;
+	return GF_OK;
+}
+
+/* Sends a frame that only references the source bits */
+static GF_Err BMP1BPP_send_lazy(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job)
+{
+	GF_FilterPacket *pck_dst;
+	GF_Err e = BMP1BPP_send_lazy_packet(stack, pck, job, &pck_dst);
+	if (e) return e;
+
+	gf_filter_pck_merge_properties(pck, pck_dst);
+	if (stack->preview)
+		gf_filter_pck_set_property_str(pck_dst, "bmp_quality", &PROP_UINT(1));
+	gf_filter_pck_send(pck_dst);
+	return GF_OK;
+}
+
+/* Creates an output packet of size bytes, on a recycled frame if possible */
+static GF_FilterPacket *BMP1BPP_new_frame_packet(GF_BaseFilter *stack, GF_FilterPid *pid, u32 size, u8 **data)
+{
+	GF_FilterPacket *pck_dst = NULL;
+
+	*data = FramePool_Get(&stack->frames, size);
+	if (*data)
+	{
+		pck_dst = gf_filter_pck_new_shared(pid, *data, size, BMP1BPP_frame_release);
+		if (!pck_dst)
+			FramePool_Put(&stack->frames, *data);
+	}
+	if (!pck_dst)
+		pck_dst = gf_filter_pck_new_alloc(pid, size, data);
+	return pck_dst;
+}
+
+/* Output PIDs carry the input properties, as raw video */
+/* Whether whole frames are output at another size; initialize leaves osize, downscale and upscale set only when they apply */
+static Bool BMP1BPP_scales_frames(const GF_BaseFilter *stack)
+{
+	return (stack->osize.x || stack->downscale > 1 || stack->upscale > 1) ? GF_TRUE : GF_FALSE;
+}
+
+static void BMP1BPP_setup_output(GF_BaseFilter *stack, GF_FilterPid *pid)
+{
+	gf_filter_pid_copy_properties(pid, stack->src_pid);
+
+	// added these
+	gf_filter_pid_set_property(pid, GF_PROP_PID_CODECID, &PROP_UINT(GF_CODECID_RAW));
+	gf_filter_pid_set_property(pid, GF_PROP_PID_STREAM_TYPE, &PROP_UINT(GF_STREAM_VISUAL));
+	if (stack->packed) {
+		gf_filter_pid_set_property(pid, GF_PROP_PID_PIXFMT, & PROP_UINT( BMP_PIXEL_PACKED1 ));
+		gf_filter_pid_set_property_str(pid, "bmp_bitorder", & PROP_STRING( "msb" ));
+	} else {
+		gf_filter_pid_set_property(pid, GF_PROP_PID_PIXFMT, & PROP_UINT( stack->pfmt ));
+	}
+}
+
+/* Sets a property of the output PID only when its value changes, each set reconfiguring the PID downstream */
+static void BMP1BPP_update_pid_uint(GF_FilterPid *pid, u32 prop, u32 val)
+{
+	const GF_PropertyValue *cur = gf_filter_pid_get_property(pid, prop);
+	if (!cur || cur->value.uint != val)
+		gf_filter_pid_set_property(pid, prop, &PROP_UINT(val));
+}
+
+static void BMP1BPP_update_pid_uint_str(GF_FilterPid *pid, const char *name, u32 val)
+{
+	const GF_PropertyValue *cur = gf_filter_pid_get_property_str(pid, name);
+	if (!cur || cur->value.uint != val)
+		gf_filter_pid_set_property_str(pid, name, &PROP_UINT(val));
+}
+
+/* Sends the source bits as they are. Top-down images reference the input packet,
+bottom-up ones only need their rows put back in order */
+static GF_Err BMP1BPP_send_packed(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job)
+{
+	u32 i, frame_size;
+	u8 *data_dst;
+	GF_FilterPacket *pck_dst;
+	struct BMP_struct *bmp = &stack->bmp;
+	const GF_PropertyValue *palette;
+	UCHAR color[2][3];
+
+	GetPaletteColors(bmp, color);
+	BMP1BPP_update_pid_uint(stack->dst_pid, GF_PROP_PID_STRIDE, job->SrcStride);
+	palette = gf_filter_pid_get_property_str(stack->dst_pid, "bmp_palette");
+	if (!palette || palette->value.data.size != sizeof(color) || memcmp(palette->value.data.ptr, color, sizeof(color)))
+		gf_filter_pid_set_property_str(stack->dst_pid, "bmp_palette", &PROP_DATA((u8 *) color, sizeof(color)));
+
+	frame_size = job->SrcStride * job->Height;
+	if (job->Orientation == 1)
+	{
+		pck_dst = gf_filter_pck_new_ref(stack->dst_pid, (u32) bmp->dataInd, frame_size, pck);
+		if (!pck_dst) return GF_OUT_OF_MEM;
+	}
+	else
+	{
+		pck_dst = BMP1BPP_new_frame_packet(stack, stack->dst_pid, frame_size, &data_dst);
+		if (!pck_dst) return GF_OUT_OF_MEM;
+		for (i=0; i<job->Height; i++)
+			memcpy(data_dst + (job->Height-1-i) * job->SrcStride, job->Src + i * job->SrcStride, job->SrcStride);
+	}
+
+	gf_filter_pck_merge_properties(pck, pck_dst);
+	gf_filter_pck_send(pck_dst);
+	return GF_OK;
+}
+
+/* Destructor of packets backed by a frame allocated outside the pool */
+static void BMP1BPP_frame_free(GF_Filter *filter, GF_FilterPid *pid, GF_FilterPacket *pck)
+{
+	u32 size;
+	GF_BaseFilter *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
+	const u8 *data = gf_filter_pck_get_data(pck, &size);
+
+	if (data)
+		BMP_Free(&stack->bmp.Stats, (void *) data);
+}
+
+/* Sets the frame size of the output PID when it differs from the current one */
+static void BMP1BPP_set_geometry(GF_BaseFilter *stack, UINT width, UINT height, UINT *cur_width, UINT *cur_height)
+{
+	UINT stride, stride_uv;
+
+	if (width != *cur_width) {
+		GetFrameLayout(stack->pfmt, width, height, &stride, &stride_uv);
+		gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_WIDTH, &PROP_UINT(width));
+		gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_STRIDE, &PROP_UINT(stride));
+		if (stride_uv)
+			gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_STRIDE_UV, &PROP_UINT(stride_uv));
+		*cur_width = width;
+	}
+	if (height != *cur_height) {
+		gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_HEIGHT, &PROP_UINT(height));
+		*cur_height = height;
+	}
+}
+
+/* Packet properties locating a region: index, left column and top row */
+static const char *BMP_TileProps[3] = { "bmp_tile_id", "bmp_tile_x", "bmp_tile_y" };
+static const char *BMP_RoiProps[3] = { "bmp_roi_id", "bmp_roi_x", "bmp_roi_y" };
+
+/* Sends regions of the image, one packet each. The regions are decoded in parallel, each
+   one straight from the source bits, then sent in order with the PID geometry following
+   their size. start and end flag the first and last region as frame start and end */
+static GF_Err BMP1BPP_send_regions(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job,
+	const struct BMP_Rect *rects, UINT nb_rects, const char *props[3], UINT *cur_w, UINT *cur_h, Bool start, Bool end)
+{
+	struct BMP_struct *bmp = &stack->bmp;
+	struct BMP_DecodeJob *regions;
+	UCHAR **frames;
+	Bool *pooled;
+	GF_FilterPacket *pck_dst;
+	UINT i, stride, stride_uv;
+	u32 size;
+	GF_Err e = GF_OK;
+
+	regions = (struct BMP_DecodeJob *) BMP_Malloc(&bmp->Stats, nb_rects * sizeof(struct BMP_DecodeJob));
+	frames = (UCHAR **) BMP_Calloc(&bmp->Stats, nb_rects, sizeof(UCHAR *));
+	pooled = (Bool *) BMP_Calloc(&bmp->Stats, nb_rects, sizeof(Bool));
+	if (!regions || !frames || !pooled) {
+		e = GF_OUT_OF_MEM;
+		goto exit;
+	}
+
+	for (i = 0; i < nb_rects; i++) {
+		TileJob(job, rects[i].X, rects[i].Y, rects[i].Width, rects[i].Height, &regions[i]);
+		if (stack->lazy) continue;
+
+		size = (u32) GetFrameLayout(stack->pfmt, rects[i].Width, rects[i].Height, &stride, &stride_uv);
+		frames[i] = FramePool_Get(&stack->frames, size);
+		pooled[i] = frames[i] ? GF_TRUE : GF_FALSE;
+		if (!frames[i])
+			frames[i] = (UCHAR *) BMP_Malloc(&bmp->Stats, size);
+		if (!frames[i]) {
+			e = GF_OUT_OF_MEM;
+			goto exit;
+		}
+		SetJobOutput(&regions[i], &bmp->Expand, frames[i], stride);
+	}
+	if (!stack->lazy)
+		WorkerPool_RunBatch(stack->pool, regions, nb_rects);
+
+	for (i = 0; i < nb_rects; i++) {
+		BMP1BPP_set_geometry(stack, rects[i].Width, rects[i].Height, cur_w, cur_h);
+		if (stack->lazy) {
+			e = BMP1BPP_send_lazy_packet(stack, pck, &regions[i], &pck_dst);
+			if (e) goto exit;
+		} else {
+			size = (u32) GetFrameLayout(stack->pfmt, rects[i].Width, rects[i].Height, &stride, &stride_uv);
+			pck_dst = gf_filter_pck_new_shared(stack->dst_pid, frames[i], size, pooled[i] ? BMP1BPP_frame_release : BMP1BPP_frame_free);
+			if (!pck_dst) {
+				e = GF_OUT_OF_MEM;
+				goto exit;
+			}
+			frames[i] = NULL;
+		}
+
+		gf_filter_pck_merge_properties(pck, pck_dst);
+		gf_filter_pck_set_property_str(pck_dst, props[0], &PROP_UINT(rects[i].Id));
+		gf_filter_pck_set_property_str(pck_dst, props[1], &PROP_UINT(rects[i].X));
+		gf_filter_pck_set_property_str(pck_dst, props[2], &PROP_UINT(rects[i].Y));
+		gf_filter_pck_set_framing(pck_dst, start && !i, end && (i + 1 == nb_rects));
+		gf_filter_pck_send(pck_dst);
+	}
+
+exit:
+	//frames decoded but not sent after an error
+	for (i = 0; frames && i < nb_rects; i++) {
+		if (!frames[i]) continue;
+		if (pooled[i]) FramePool_Put(&stack->frames, frames[i]);
+		else BMP_Free(&bmp->Stats, frames[i]);
+	}
+	BMP_Free(&bmp->Stats, regions);
+	BMP_Free(&bmp->Stats, frames);
+	BMP_Free(&bmp->Stats, pooled);
+	return e;
+}
+
+/* Builds the expansion tables shared by the regions of an image, lazy frames have their own */
+static void BMP1BPP_prepare_regions(GF_BaseFilter *stack)
+{
+	UCHAR color[2][3];
+
+	if (stack->lazy) return;
+	GetPaletteColors(&stack->bmp, color);
+	BuildExpandLUT(&stack->bmp.Expand, color, stack->pfmt, 1);
+}
+
+/* Sends the image as tiles of stack->tile pixels, row by row, the tiles of a row being decoded in parallel */
+static GF_Err BMP1BPP_send_tiles(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job)
+{
+	struct BMP_Rect *rects;
+	UINT tw = (UINT) stack->tile.x, th = (UINT) stack->tile.y;
+	UINT cols, rows, tx, ty, stride, stride_uv, cur_w = 0, cur_h = 0;
+	GF_Err e = GF_OK;
+
+	cols = (job->Width + tw - 1) / tw;
+	rows = (job->Height + th - 1) / th;
+	if (GetFrameLayout(stack->pfmt, tw, th, &stride, &stride_uv) > 0xFFFFFFFFUL)
+		return GF_OUT_OF_MEM;
+
+	gf_filter_pid_set_property_str(stack->dst_pid, "bmp_full_width", &PROP_UINT(job->Width));
+	gf_filter_pid_set_property_str(stack->dst_pid, "bmp_full_height", &PROP_UINT(job->Height));
+	gf_filter_pid_set_property_str(stack->dst_pid, "bmp_tile_cols", &PROP_UINT(cols));
+	gf_filter_pid_set_property_str(stack->dst_pid, "bmp_tile_rows", &PROP_UINT(rows));
+
+	rects = (struct BMP_Rect *) BMP_Malloc(&stack->bmp.Stats, cols * sizeof(struct BMP_Rect));
+	if (!rects) return GF_OUT_OF_MEM;
+	BMP1BPP_prepare_regions(stack);
+
+	for (ty = 0; ty < rows && !e; ty++) {
+		for (tx = 0; tx < cols; tx++) {
+			rects[tx].Id = ty * cols + tx;
+			rects[tx].X = tx * tw;
+			rects[tx].Y = ty * th;
+			rects[tx].Width = (tx + 1 < cols) ? tw : job->Width - tx * tw;
+			rects[tx].Height = (ty + 1 < rows) ? th : job->Height - ty * th;
+		}
+		e = BMP1BPP_send_regions(stack, pck, job, rects, cols, BMP_TileProps, &cur_w, &cur_h, ty == 0, ty + 1 == rows);
+	}
+	BMP_Free(&stack->bmp.Stats, rects);
+	return e;
+}
+
+/* Sends the regions of interest set by the roi option, clipped to the image */
+static GF_Err BMP1BPP_send_rois(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job)
+{
+	struct BMP_Rect *rects;
+	UINT i, nb = 0, cur_w = 0, cur_h = 0;
+	GF_Err e = GF_OK;
+
+	rects = (struct BMP_Rect *) BMP_Malloc(&stack->bmp.Stats, stack->nb_rois * sizeof(struct BMP_Rect));
+	if (!rects) return GF_OUT_OF_MEM;
+
+	for (i = 0; i < stack->nb_rois; i++) {
+		struct BMP_Rect r = stack->rois[i];
+		if (r.X >= job->Width || r.Y >= job->Height) continue;
+		if (r.Width > job->Width - r.X) r.Width = job->Width - r.X;
+		if (r.Height > job->Height - r.Y) r.Height = job->Height - r.Y;
+		rects[nb++] = r;
+	}
+
+	gf_filter_pid_set_property_str(stack->dst_pid, "bmp_full_width", &PROP_UINT(job->Width));
+	gf_filter_pid_set_property_str(stack->dst_pid, "bmp_full_height", &PROP_UINT(job->Height));
+	if (nb) {
+		BMP1BPP_prepare_regions(stack);
+		e = BMP1BPP_send_regions(stack, pck, job, rects, nb, BMP_RoiProps, &cur_w, &cur_h, GF_TRUE, GF_TRUE);
+	} else {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] no region of interest inside the %ux%u image\n", (u32) job->Width, (u32) job->Height));
+	}
+	BMP_Free(&stack->bmp.Stats, rects);
+	return e;
+}
+
+/* Parses the roi option, rectangles given as WxH+X+Y */
+static GF_Err BMP1BPP_set_rois(GF_BaseFilter *stack, const GF_PropStringList *list)
+{
+	struct BMP_Rect *rects = NULL;
+	u32 i, nb = 0;
+	u32 x, y, w, h;
+
+	if (list && list->nb_items) {
+		rects = (struct BMP_Rect *) BMP_Malloc(&stack->bmp.Stats, list->nb_items * sizeof(struct BMP_Rect));
+		if (!rects) return GF_OUT_OF_MEM;
+	}
+	for (i = 0; list && i < list->nb_items; i++) {
+		if (!list->vals[i] || sscanf(list->vals[i], "%ux%u+%u+%u", &w, &h, &x, &y) != 4 || !w || !h) {
+			GF_LOG(GF_LOG_ERROR, GF_LOG_CODEC, ("[BMP1BPP] invalid region of interest %s, expecting WxH+X+Y\n", list->vals[i] ? list->vals[i] : "(null)"));
+			BMP_Free(&stack->bmp.Stats, rects);
+			return GF_BAD_PARAM;
+		}
+		rects[nb].Id = i;
+		rects[nb].X = x;
+		rects[nb].Y = y;
+		rects[nb].Width = w;
+		rects[nb].Height = h;
+		nb++;
+	}
+
+	BMP_Free(&stack->bmp.Stats, stack->rois);
+	stack->rois = rects;
+	stack->nb_rois = nb;
+	return GF_OK;
+}
+
+/* Number of reduced levels of a w x h image, halved until both sides fit in the smallest level size,
+with their sizes in levels if not NULL */
+static u32 BMP1BPP_pyramid_levels(const GF_BaseFilter *stack, UINT w, UINT h, struct BMP_Level *levels)
+{
+	u32 nb = 0;
+	while ((w > stack->pyramid || h > stack->pyramid) && nb < BMP_MAX_LEVELS) {
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+		if (levels) {
+			levels[nb].Width = w;
+			levels[nb].Height = h;
+		}
+		nb++;
+	}
+	return nb;
+}
+
+/* Declares the level PIDs along with the full-size one: as many as the size announced on the input PID needs,
+or the most a pyramid can have when it is not known */
+static GF_Err BMP1BPP_setup_levels(GF_Filter *filter, GF_BaseFilter *stack)
+{
+	const GF_PropertyValue *w = gf_filter_pid_get_property(stack->src_pid, GF_PROP_PID_WIDTH);
+	const GF_PropertyValue *h = gf_filter_pid_get_property(stack->src_pid, GF_PROP_PID_HEIGHT);
+	u32 nb = BMP_MAX_LEVELS;
+	GF_FilterPid *pid;
+
+	if (w && h && w->value.uint && h->value.uint)
+		nb = BMP1BPP_pyramid_levels(stack, w->value.uint, h->value.uint, NULL);
+
+	while (stack->nb_level_pids < nb) {
+		pid = gf_filter_pid_new(filter);
+		if (!pid) return GF_OUT_OF_MEM;
+		BMP1BPP_setup_output(stack, pid);
+		gf_filter_pid_set_property_str(pid, "bmp_pyramid_level", &PROP_UINT(stack->nb_level_pids + 1));
+		stack->level_eos[stack->nb_level_pids] = GF_FALSE;
+		stack->level_pids[stack->nb_level_pids++] = pid;
+	}
+	return GF_OK;
+}
+
+/* Decodes the full frame and its reduced levels in one pass, each level going out on its own PID */
+static GF_Err BMP1BPP_send_pyramid(GF_BaseFilter *stack, GF_FilterPacket *pck, struct BMP_DecodeJob *job)
+{
+	struct BMP_Level levels[BMP_MAX_LEVELS];
+	GF_FilterPacket *pck_levels[BMP_MAX_LEVELS];
 	GF_FilterPacket *pck_dst;
-	GF_BaseFilter *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
+	GF_FilterPid *pid;
+	UINT stride, stride_uv;
+	u64 size64;
+	u8 *data_dst;
+	u32 i, nb;
+
+	nb = BMP1BPP_pyramid_levels(stack, job->Width, job->Height, levels);
+	//larger than the input PID announced
+	if (nb > stack->nb_level_pids) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] %ux%u image needs %u pyramid levels, only %u declared\n", job->Width, job->Height, nb, stack->nb_level_pids));
+		nb = stack->nb_level_pids;
+	}
+
+	size64 = GetFrameLayout(stack->pfmt, job->Width, job->Height, &stride, &stride_uv);
+	if (size64 > 0xFFFFFFFFUL) {
+		GF_LOG(GF_LOG_ERROR, GF_LOG_CODEC, ("[BMP1BPP] output frame of " LLU " bytes does not fit in a packet\n", size64));
+		return GF_OUT_OF_MEM;
+	}
+	pck_dst = BMP1BPP_new_frame_packet(stack, stack->dst_pid, (u32) size64, &data_dst);
+	if (!pck_dst) return GF_OUT_OF_MEM;
+
+	for (i=0; i<nb; i++) {
+		pid = stack->level_pids[i];
+		size64 = GetFrameLayout(stack->pfmt, levels[i].Width, levels[i].Height, &levels[i].DstStride, &stride_uv);
+		BMP1BPP_update_pid_uint(pid, GF_PROP_PID_WIDTH, levels[i].Width);
+		BMP1BPP_update_pid_uint(pid, GF_PROP_PID_HEIGHT, levels[i].Height);
+		BMP1BPP_update_pid_uint(pid, GF_PROP_PID_STRIDE, levels[i].DstStride);
+		pck_levels[i] = BMP1BPP_new_frame_packet(stack, pid, (u32) size64, &levels[i].Dst);
+		if (!pck_levels[i]) {
+			gf_filter_pck_discard(pck_dst);
+			while (i--)
+				gf_filter_pck_discard(pck_levels[i]);
+			return GF_OUT_OF_MEM;
+		}
+	}
+
+	job->Levels = levels;
+	job->NbLevels = nb;
+	if (dec1(&stack->bmp, job, stack->pfmt, data_dst, stride, stack->pool) != GF_OK) {
+		job->Levels = NULL;
+		job->NbLevels = 0;
+		gf_filter_pck_discard(pck_dst);
+		for (i=0; i<nb; i++)
+			gf_filter_pck_discard(pck_levels[i]);
+		return GF_NOT_SUPPORTED;
+	}
+	job->Levels = NULL;
+	job->NbLevels = 0;
+
+	gf_filter_pck_merge_properties(pck, pck_dst);
+	gf_filter_pck_send(pck_dst);
+	for (i=0; i<nb; i++) {
+		gf_filter_pck_merge_properties(pck, pck_levels[i]);
+		gf_filter_pck_send(pck_levels[i]);
+		stack->level_eos[i] = GF_FALSE;
+	}
+	//levels too small for this image end until one needs them again
+	for (i=nb; i<stack->nb_level_pids; i++) {
+		if (stack->level_eos[i]) continue;
+		gf_filter_pid_set_eos(stack->level_pids[i]);
+		stack->level_eos[i] = GF_TRUE;
+	}
+	return GF_OK;
+}
+
+/* Sends a preview sampled from one row and column in stack->preview, ahead of the full frame.
+The PID geometry is the preview's for this packet only */
+static GF_Err BMP1BPP_send_preview(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job)
+{
+	struct BMP_DecodeJob preview = *job;
+	GF_FilterPacket *pck_dst;
+	UINT stride, stride_uv, cur_w, cur_h;
+	u8 *data_dst;
+
+	SampleJob(&preview, stack->preview);
+	cur_w = job->Width;
+	cur_h = job->Height;
+	BMP1BPP_set_geometry(stack, preview.Width, preview.Height, &cur_w, &cur_h);
+
+	pck_dst = BMP1BPP_new_frame_packet(stack, stack->dst_pid, (u32) GetFrameLayout(stack->pfmt, preview.Width, preview.Height, &stride, &stride_uv), &data_dst);
+	if (!pck_dst) return GF_OUT_OF_MEM;
+	if (dec1(&stack->bmp, &preview, stack->pfmt, data_dst, stride, stack->pool) != GF_OK) {
+		gf_filter_pck_discard(pck_dst);
+		BMP1BPP_set_geometry(stack, job->Width, job->Height, &cur_w, &cur_h);
+		return GF_NOT_SUPPORTED;
+	}
+
+	gf_filter_pck_merge_properties(pck, pck_dst);
+	gf_filter_pck_set_property_str(pck_dst, "bmp_quality", &PROP_UINT(0));
+	gf_filter_pck_send(pck_dst);
+
+	BMP1BPP_set_geometry(stack, job->Width, job->Height, &cur_w, &cur_h);
+	return GF_OK;
+}
+
+/* Sends the image as packets of at most stack->strip rows, top strip first */
+static GF_Err BMP1BPP_send_strips(GF_BaseFilter *stack, GF_FilterPacket *pck, const struct BMP_DecodeJob *job)
+{
+	struct BMP_struct *bmp = &stack->bmp;
+	struct BMP_DecodeJob slice;
+	GF_FilterPacket *pck_dst;
+	UINT stride, stride_uv, first, rows, nb_rows;
+	u64 row_size;
+	u8 *data_dst;
+	GF_Err e;
+
+	//strips must fit in a packet, and cover whole chroma rows
+	row_size = GetFrameLayout(stack->pfmt, job->Width, 2, &stride, &stride_uv) / 2 + 1;
+	rows = stack->strip;
+	if ((u64) rows * row_size > 0xFFFFFFFFUL)
+		rows = (UINT) (0xFFFFFFFFUL / row_size);
+	if (stride_uv)
+		rows = (rows + 1) & ~1;
+	if (!rows)
+		return GF_OUT_OF_MEM;
+
+	//the PID keeps the strip height, a shorter last strip carries its own
+	BMP1BPP_update_pid_uint(stack->dst_pid, GF_PROP_PID_HEIGHT, rows);
+	BMP1BPP_update_pid_uint_str(stack->dst_pid, "bmp_full_width", job->Width);
+	BMP1BPP_update_pid_uint_str(stack->dst_pid, "bmp_full_height", job->Height);
+
+	for (first = 0; first < job->Height; first += nb_rows) {
+		nb_rows = job->Height - first;
+		if (nb_rows > rows) nb_rows = rows;
+		SliceJob(job, first, nb_rows, &slice);
+
+		if (stack->lazy) {
+			e = BMP1BPP_send_lazy_packet(stack, pck, &slice, &pck_dst);
+			if (e) return e;
+		} else {
+			pck_dst = BMP1BPP_new_frame_packet(stack, stack->dst_pid, (u32) GetFrameLayout(stack->pfmt, job->Width, nb_rows, &stride, &stride_uv), &data_dst);
+			if (!pck_dst) return GF_OUT_OF_MEM;
+			if (dec1(bmp, &slice, stack->pfmt, data_dst, stride, stack->pool) != GF_OK) {
+				gf_filter_pck_discard(pck_dst);
+				return GF_NOT_SUPPORTED;
+			}
+		}
+
+		//position of the strip in the full image, the byte offset is in plane 0
+		gf_filter_pck_merge_properties(pck, pck_dst);
+		gf_filter_pck_set_property_str(pck_dst, "bmp_strip_y", &PROP_UINT(first));
+		gf_filter_pck_set_property_str(pck_dst, "bmp_strip_offset", &PROP_LONGUINT((u64) first * stride));
+		if (first + nb_rows == job->Height)
+			gf_filter_pck_set_property_str(pck_dst, "bmp_strip_height", &PROP_UINT(nb_rows));
+		gf_filter_pck_set_framing(pck_dst, first == 0, first + nb_rows == job->Height);
+		gf_filter_pck_send(pck_dst);
+	}
+	return GF_OK;
+}
+
+/*********************************** Unframed input **********************************/
+
+/* Grows a stream buffer to hold at least size bytes, keeping its content */
+static Bool BMP1BPP_stream_reserve(GF_BaseFilter *stack, UCHAR **buf, UINT *alloc, UINT used, UINT size)
+{
+	UCHAR *nbuf;
+	if (*alloc >= size) return GF_TRUE;
+	nbuf = (UCHAR *) BMP_Malloc(&stack->bmp.Stats, size);
+	if (!nbuf) return GF_FALSE;
+	if (used) memcpy(nbuf, *buf, used);
+	BMP_Free(&stack->bmp.Stats, *buf);
+	*buf = nbuf;
+	*alloc = size;
+	return GF_TRUE;
+}
+
+/* Drops the image in progress, if any */
+static void BMP1BPP_stream_reset(GF_BaseFilter *stack)
+{
+	struct BMP_Stream *st = &stack->unframed;
+	if (st->Frame) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] image truncated after %u of %u rows, dropping it\n", (u32) st->Rows, (u32) st->Job.Height));
+		gf_filter_pck_discard(st->Frame);
+		st->Frame = NULL;
+	}
+	st->HeadSize = 0;
+	st->CarrySize = 0;
+	st->Rows = 0;
+	st->InImage = GF_FALSE;
+}
+
+/* Parses the collected header and sets up the output frame the rows are decoded into */
+static GF_Err BMP1BPP_stream_start(GF_BaseFilter *stack)
+{
+	struct BMP_Stream *st = &stack->unframed;
+	struct BMP_struct *bmp = &stack->bmp;
+	UCHAR color[2][3];
+	UINT stride, stride_uv;
+	u32 frame_size;
+	u64 size64;
+	u8 *data_dst;
+
+	bmp->dataInd = 0;
+	if (ReadHeader(bmp, (const char *) st->Head, st->HeadSize) != GF_OK)
+		return GF_NOT_SUPPORTED;
+	if (bmp->Header.BitsPerPixel != 1 || bmp->Header.CompressionType != 0)
+		return GF_NOT_SUPPORTED;
+	/* the header announces the file size, check the rows fit in it as for framed input */
+	if (SetupDecodeJob(bmp, (const char *) st->Head, (int) bmp->Header.FileSize, &st->Job) != GF_OK)
+		return GF_NON_COMPLIANT_BITSTREAM;
+	/* rows are counted in whole source strides as their bytes arrive */
+	if (!st->Job.Width || !st->Job.Height || !st->Job.SrcStride)
+		return GF_NON_COMPLIANT_BITSTREAM;
+	if (!BMP1BPP_stream_reserve(stack, &st->Carry, &st->CarryAlloc, 0, 2 * st->Job.SrcStride))
+		return GF_OUT_OF_MEM;
+
+	size64 = GetFrameLayout(stack->pfmt, BMP_GetWidth(bmp), BMP_GetHeight(bmp), &stride, &stride_uv);
+	if (size64 > 0xFFFFFFFFUL) {
+		GF_LOG(GF_LOG_ERROR, GF_LOG_CODEC, ("[BMP1BPP] output frame of " LLU " bytes does not fit in a packet\n", size64));
+		return GF_OUT_OF_MEM;
+	}
+	frame_size = (u32) size64;
+	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_WIDTH, &PROP_UINT(BMP_GetWidth(bmp)));
+	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_HEIGHT, &PROP_UINT(BMP_GetHeight(bmp)));
+	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_STRIDE, &PROP_UINT(stride));
+	if (stride_uv)
+		gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_STRIDE_UV, &PROP_UINT(stride_uv));
+
+	st->Frame = BMP1BPP_new_frame_packet(stack, stack->dst_pid, frame_size, &data_dst);
+	if (!st->Frame) return GF_OUT_OF_MEM;
+
+	GetPaletteColors(bmp, color);
+	BuildExpandLUT(&bmp->Expand, color, stack->pfmt, 1);
+	SetJobOutput(&st->Job, &bmp->Expand, data_dst, stride);
+	st->InImage = GF_TRUE;
+	st->Rows = 0;
+	st->CarrySize = 0;
+	return GF_OK;
+}
+
+/* Number of rows from the current one to the next chunk boundary: chunks of YUV
+   output must cover whole chroma rows, i.e. start on an even output row */
+static UINT BMP1BPP_stream_unit(const struct BMP_Stream *st)
+{
+	UINT phase, left = st->Job.Height - st->Rows;
+	if (!st->Job.DstU || left < 2) return 1;
+	/* bottom-up images of odd height start with the last, lone output row */
+	phase = (st->Job.Orientation == 0) ? (st->Job.Height & 1) : 0;
+	return ((st->Rows - phase) & 1) ? 1 : 2;
+}
+
+/* Decodes the next nbRows source rows, stored contiguously at src */
+static void BMP1BPP_stream_decode(GF_BaseFilter *stack, const UCHAR *src, UINT nbRows)
+{
+	struct BMP_Stream *st = &stack->unframed;
+	struct BMP_DecodeJob chunk = st->Job;
+	UINT first;
+
+	/* output row of the chunk's top row */
+	first = st->Job.Orientation ? st->Rows : st->Job.Height - st->Rows - nbRows;
+	chunk.Src = src;
+	chunk.Height = chunk.SrcHeight = nbRows;
+	chunk.Dst += first * chunk.DstStride;
+	if (chunk.DstU) {
+		chunk.DstU += (first / 2) * chunk.ChromaStride;
+		chunk.DstV += (first / 2) * chunk.ChromaStride;
+	}
+	WorkerPool_Run(stack->pool, &chunk);
+	st->Rows += nbRows;
+}
+
+/* Feeds one block of file bytes, decoding every row it completes */
+static GF_Err BMP1BPP_stream_block(GF_BaseFilter *stack, GF_FilterPacket *pck, const u8 *data, u32 size)
+{
+	struct BMP_Stream *st = &stack->unframed;
+	UINT need, n, unit;
+	GF_Err e;
+
+	while (size) {
+		if (!st->InImage) {
+			if (st->Job.Height && st->Rows == st->Job.Height)
+				return GF_OK; /* image done, skip trailing bytes until the next file */
+
+			/* the file header gives the offset of the pixel rows, everything before them is parsed at once */
+			need = 14;
+			if (st->HeadSize >= 14) {
+				need = BMP_LE32(st->Head + 10);
+				/* at least the file header and the 12-byte core header */
+				if (need < 26 || need > (1 << 20)) return GF_NON_COMPLIANT_BITSTREAM;
+			}
+			n = need - st->HeadSize;
+			if (n > size) n = size;
+			if (!BMP1BPP_stream_reserve(stack, &st->Head, &st->HeadAlloc, st->HeadSize, need))
+				return GF_OUT_OF_MEM;
+			memcpy(st->Head + st->HeadSize, data, n);
+			st->HeadSize += n;
+			data += n;
+			size -= n;
+			if (st->HeadSize < 14 || st->HeadSize < need) continue;
+			if (need == 14) continue;
+
+			e = BMP1BPP_stream_start(stack);
+			if (e) return e;
+			continue;
+		}
 
+		unit = BMP1BPP_stream_unit(st) * st->Job.SrcStride;
+		if (st->CarrySize || size < unit) {
+			/* complete a chunk split across blocks */
+			n = unit - st->CarrySize;
+			if (n > size) n = size;
+			memcpy(st->Carry + st->CarrySize, data, n);
+			st->CarrySize += n;
+			data += n;
+			size -= n;
+			if (st->CarrySize == unit) {
+				BMP1BPP_stream_decode(stack, st->Carry, unit / st->Job.SrcStride);
+				st->CarrySize = 0;
+			}
+		} else {
+			/* decode the whole rows of the block in place, ending on a chunk boundary */
+			n = size / st->Job.SrcStride;
+			if (n > st->Job.Height - st->Rows)
+				n = st->Job.Height - st->Rows;
+			if (st->Job.DstU && st->Rows + n < st->Job.Height) {
+				UINT phase = (st->Job.Orientation == 0) ? (st->Job.Height & 1) : 0;
+				if ((st->Rows + n - phase) & 1) n--;
+			}
+			BMP1BPP_stream_decode(stack, data, n);
+			data += n * st->Job.SrcStride;
+			size -= n * st->Job.SrcStride;
+		}
+
+		if (st->Rows == st->Job.Height) {
+			gf_filter_pck_merge_properties(pck, st->Frame);
+			gf_filter_pck_send(st->Frame);
+			st->Frame = NULL;
+			st->InImage = GF_FALSE;
+			st->HeadSize = 0;
+		}
+	}
+	return GF_OK;
+}
+
+/* Unframed input: blocks are consumed as they arrive, the file is never reassembled */
+static GF_Err BMP1BPP_process_stream(GF_BaseFilter *stack)
+{
+	Bool start, end;
+	const u8 *data;
+	u32 size;
+	GF_Err e;
 	GF_FilterPacket *pck = gf_filter_pid_get_packet(stack->src_pid);
+
+	if (!pck) {
+		if (gf_filter_pid_is_eos(stack->src_pid)) {
+			BMP1BPP_stream_reset(stack);
+			return GF_EOS;
+		}
+		return GF_OK;
+	}
+
+	gf_filter_pck_get_framing(pck, &start, &end);
+	if (start) {
+		BMP1BPP_stream_reset(stack);
+		stack->unframed.Job.Height = 0;
+	}
+
+	data = gf_filter_pck_get_data(pck, &size);
+	e = data ? BMP1BPP_stream_block(stack, pck, data, size) : GF_OK;
+	if (e) {
+		BMP1BPP_stream_reset(stack);
+		stack->unframed.Job.Height = 0;
+	}
+	gf_filter_pid_drop_packet(stack->src_pid);
+	return e;
+}
+
+static GF_Err BMP1BPP_filter_process(GF_Filter *filter)
+{
+	struct BMP_DecodeJob job;
+	u32 frame_size;
+	u64 size64;
+	UINT stride, stride_uv;
+	u8 *data_dst;
+	const u8 *data_src;
+	u32 size;
+
+	GF_FilterPacket *pck_dst;
+	GF_BaseFilter *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
+	/* all decoder state lives in the filter instance */
+	struct BMP_struct *bmp = &stack->bmp;
+	GF_FilterPacket *pck;
+
+	if (stack->stream)
+		return BMP1BPP_process_stream(stack);
+
+	pck = gf_filter_pid_get_packet(stack->src_pid);
 	if (!pck) return GF_OK;
 	data_src = gf_filter_pck_get_data(pck, &size);
 
 	
-	char * bmp_data = data_src;
-	int i;
-	dataInd = 0; // init our index into the data 
-	scanLinePadding = 0; 
+	const char * bmp_data = (const char *) data_src;
 
-	/* Allocate */
-  	bmp = (struct BMP_struct*) malloc( sizeof( struct BMP_struct ) );
-	if ( bmp == NULL )
-	{
-		return GF_OUT_OF_MEM;
-	}
+	/* same header and palette as the previous image: decode straight away */
+	if ( UseDecodePlan( bmp, bmp_data, size, &job ) )
+		goto decode;
+
+	bmp->dataInd = 0; // init our index into the data 
+	bmp->scanLinePadding = 0; 
 
 
 	/* Read header */
-	if ( ReadHeader( bmp_data, size) != GF_OK  )
+	if ( ReadHeader( bmp, bmp_data, size) != GF_OK  )
 	{
-		free( bmp );
 		return GF_NOT_SUPPORTED;
 	}
 
@@ -502,82 +3832,139 @@ static GF_Err BMP1BPP_filter_process(GF_Filter *filter)
 	/* first check permitted BPP */
 	if ( bmp->Header.BitsPerPixel != 1  )
 	{
-		free( bmp );
 		return GF_NOT_SUPPORTED;
 	}
 	/* next check CompressionType and permitted header sizes */
 	if (  bmp->Header.CompressionType != 0 && bmp->Header.HeaderSize != 40 )
 	{
-		free( bmp );
 		return GF_NOT_SUPPORTED;
 	}
 
-	/* Allocate memory for image data */
-	bmp->Data = (UCHAR*) malloc( bmp->Header.Width* bmp->Header.Height * 3); /* forcing RGB output*/
-	if ( bmp->Data == NULL )
-	{
-		free( bmp->Palette );
-		free( bmp );
-		return GF_OUT_OF_MEM;
-	}
-	
-	
-	/* do the decode */
-	if (bmp->Header.BitsPerPixel == 1)
+	/* locate the pixel rows, checking once that they are all in the file */
+	if ( SetupDecodeJob( bmp, bmp_data, size, &job ) != GF_OK )
 	{
-			if (dec1(bmp_data) != GF_OK) return GF_NOT_SUPPORTED;
+		return GF_NON_COMPLIANT_BITSTREAM;
 	}
-	else // shouldn't reach here if did earlier sanity check 
-			return GF_NOT_SUPPORTED;
+	SaveDecodePlan( bmp, bmp_data, &job );
 
+decode:
+	//resample mode: whole frames only, never set along with regions, tiles or strips
+	if (stack->osize.x)
+		ResampleJob(&job, stack->osize.x, stack->osize.y);
+	//downscale mode: whole frames only
+	else if (stack->downscale > 1)
+		ScaleJob(&job, stack->downscale);
+	//upscale mode: whole frames only
+	else if (stack->upscale > 1)
+		ZoomJob(&job, stack->upscale);
 
-//for debugging
-		bmp->Header.Orientation = 1;
-	
-	// Flip, if needed. Leave here rather than doing in-place calculation. Uses memory, but simpler.
-	if (bmp->Header.Orientation == 0) // origin in lower-left
-		{
-			UCHAR * tmpData;
-			tmpData = (UCHAR*) malloc( bmp->Header.Width* bmp->Header.Height * 3); /* forcing RGB output*/
-			if ( tmpData == NULL )
-				{
-					return GF_OUT_OF_MEM;	
-				}
-			int ascend = 0;
-			int descend = 0;
-			for (i=(bmp->Header.Height)-1; i>-1; --i) 
-				{
-					ascend = abs(bmp->Header.Height-i-1)*bmp->Header.Width*3;
-					descend = i*bmp->Header.Width*3;
-					memcpy(tmpData+ascend, bmp->Data+descend, bmp->Header.Width*3);
-				}
-			memcpy(bmp->Data,tmpData,bmp->Header.Height*bmp->Header.Width*3);
-			free(tmpData);
-		}
+	BMP1BPP_update_pid_uint(stack->dst_pid, GF_PROP_PID_WIDTH, job.Width);
+	//strips set the strip height instead
+	if (!stack->strip || stack->nb_rois || stack->tile.x)
+		BMP1BPP_update_pid_uint(stack->dst_pid, GF_PROP_PID_HEIGHT, job.Height);
 
+	//packed mode: no expansion at all
+	if (stack->packed)
+	{
+		GF_Err e = BMP1BPP_send_packed(stack, pck, &job);
+		if (e) return e;
+		gf_filter_pid_drop_packet(stack->src_pid);
+		return GF_OK;
+	}
 
+	size64 = GetFrameLayout(stack->pfmt, job.Width, job.Height, &stride, &stride_uv);
+	BMP1BPP_update_pid_uint(stack->dst_pid, GF_PROP_PID_STRIDE, stride);
+	if (stride_uv)
+		BMP1BPP_update_pid_uint(stack->dst_pid, GF_PROP_PID_STRIDE_UV, stride_uv);
 
+	//regions of interest: only the source bytes they cover are read
+	if (stack->nb_rois)
+	{
+		GF_Err e = BMP1BPP_send_rois(stack, pck, &job);
+		if (e) return e;
+		gf_filter_pid_drop_packet(stack->src_pid);
+		return GF_OK;
+	}
 
-	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_WIDTH, &PROP_UINT(BMP_GetWidth()));
-	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_HEIGHT, &PROP_UINT(BMP_GetHeight()));
-	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_STRIDE, &PROP_UINT(BMP_GetWidth()*3));	
+	//tile mode: fixed-size tiles, each decodable on its own
+	if (stack->tile.x && stack->tile.y)
+	{
+		GF_Err e = BMP1BPP_send_tiles(stack, pck, &job);
+		if (e) return e;
+		gf_filter_pid_drop_packet(stack->src_pid);
+		return GF_OK;
+	}
 
-	
-	//produce output packet using memory allocation
-	pck_dst = gf_filter_pck_new_alloc(stack->dst_pid, BMP_GetWidth()*BMP_GetHeight()*3, &data_dst);
+	//strip mode: bounded packets, whatever the image size
+	if (stack->strip)
+	{
+		GF_Err e = BMP1BPP_send_strips(stack, pck, &job);
+		if (e) return e;
+		gf_filter_pid_drop_packet(stack->src_pid);
+		return GF_OK;
+	}
+	//pyramid mode: the full frame and its reduced levels from one pass
+	if (stack->pyramid)
+	{
+		GF_Err e = BMP1BPP_send_pyramid(stack, pck, &job);
+		if (e) return e;
+		gf_filter_pid_drop_packet(stack->src_pid);
+		return GF_OK;
+	}
 
-	memcpy(data_dst, bmp->Data,  BMP_GetWidth()*BMP_GetHeight()*3);
+	if (size64 > 0xFFFFFFFFUL)
+	{
+		GF_LOG(GF_LOG_ERROR, GF_LOG_CODEC, ("[BMP1BPP] output frame of " LLU " bytes does not fit in a packet, use strip mode\n", size64));
+		return GF_OUT_OF_MEM;
+	}
+	frame_size = (u32) size64;
 
+	//progressive mode: a coarse preview goes out first, so that something shows right away
+	if (stack->preview)
+	{
+		GF_Err e = BMP1BPP_send_preview(stack, pck, &job);
+		if (e) return e;
+	}
+	
+	//lazy mode: the frame only holds the source, it is expanded if a consumer reads it
+	if (stack->lazy)
+	{
+		GF_Err e = BMP1BPP_send_lazy(stack, pck, &job);
+		if (e) return e;
+		gf_filter_pid_drop_packet(stack->src_pid);
+		return GF_OK;
+	}
 
-	//pck_dst = gf_filter_pck_new_alloc(stack->dst_pid, size, &data_dst);
-	if (!pck_dst) return GF_OUT_OF_MEM;
-	//memcpy(data_dst, data_src, size);
+	//produce output packet from a recycled frame if possible, the decode writes straight into it
+	pck_dst = BMP1BPP_new_frame_packet(stack, stack->dst_pid, frame_size, &data_dst);
+	if (!pck_dst)
+	{
+		return GF_OUT_OF_MEM;
+	}
+	
+	
+	/* do the decode, rows land in top-down order */
+	if (bmp->Header.BitsPerPixel == 1)
+	{
+			if (dec1(bmp, &job, stack->pfmt, data_dst, stride, stack->pool) != GF_OK)
+			{
+				gf_filter_pck_discard(pck_dst);
+				return GF_NOT_SUPPORTED;
+			}
+	}
+	else // shouldn't reach here if did earlier sanity check 
+	{
+			gf_filter_pck_discard(pck_dst);
+			return GF_NOT_SUPPORTED;
+	}
 
 	//no need to adjust data framing
 	//	gf_filter_pck_set_framing(pck_dst, GF_TRUE, GF_TRUE);
 
 	//copy over src props to dst
 	gf_filter_pck_merge_properties(pck, pck_dst);
+	if (stack->preview)
+		gf_filter_pck_set_property_str(pck_dst, "bmp_quality", &PROP_UINT(1));
 	gf_filter_pck_send(pck_dst);
 
 	gf_filter_pid_drop_packet(stack->src_pid);
@@ -587,7 +3974,6 @@ static GF_Err BMP1BPP_filter_process(GF_Filter *filter)
 
 static GF_Err BMP1BPP_filter_config_input(GF_Filter *filter, GF_FilterPid *pid, Bool is_remove)
 {
-	const GF_PropertyValue *format;
 	GF_PropertyValue p;
 	GF_BaseFilter  *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
 
@@ -599,6 +3985,8 @@ static GF_Err BMP1BPP_filter_config_input(GF_Filter *filter, GF_FilterPid *pid,
 			gf_filter_pid_remove(stack->src_pid);
 			stack->dst_pid = NULL;
 		}
+		while (stack->nb_level_pids)
+			gf_filter_pid_remove(stack->level_pids[--stack->nb_level_pids]);
 		stack->src_pid = NULL;
 		return GF_OK;
 		}
@@ -608,6 +3996,9 @@ static GF_Err BMP1BPP_filter_config_input(GF_Filter *filter, GF_FilterPid *pid,
 		else {
 			if (!gf_filter_pid_check_caps(pid))
 				return GF_NOT_SUPPORTED;
+			//a larger announced size needs more levels
+			if (stack->pyramid)
+				return BMP1BPP_setup_levels(filter, stack);
 		}
 		return GF_OK;
 	}
@@ -620,53 +4011,311 @@ static GF_Err BMP1BPP_filter_config_input(GF_Filter *filter, GF_FilterPid *pid,
 
 	//setup output (if we are a filter not a sink)
 	stack->src_pid = pid;
-	gf_filter_pid_set_framing_mode(pid, GF_TRUE);
 	stack->dst_pid = gf_filter_pid_new(filter);
-
-	gf_filter_pid_copy_properties(stack->dst_pid, stack->src_pid);
-
-	// added these
-	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_CODECID, &PROP_UINT(GF_CODECID_RAW));
-	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_STREAM_TYPE, &PROP_UINT(GF_STREAM_VISUAL));
-	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_PIXFMT, & PROP_UINT( GF_PIXEL_RGB ));
+	BMP1BPP_setup_output(stack, stack->dst_pid);
 	gf_filter_set_name(filter, "BMP1BPP");
+	if (stack->pyramid) {
+		GF_Err e = BMP1BPP_setup_levels(filter, stack);
+		if (e) return e;
+	}
 
 	p.type = GF_PROP_UINT;
 	p.value.uint = 10;
 	gf_filter_pid_set_property(stack->dst_pid, GF_4CC('c','u','s','2'), &p);
 
 	//set framing mode if needed - by default all PIDs require complete data blocks as inputs
-	gf_filter_pid_set_framing_mode(stack->src_pid, GF_TRUE);
+	//in stream mode the blocks are decoded as they come
+	gf_filter_pid_set_framing_mode(stack->src_pid, stack->stream ? GF_FALSE : GF_TRUE);
+
+	return GF_OK;
+}
+
+static GF_Err BMP1BPP_reconfigure_output(GF_Filter *filter, GF_FilterPid *pid)
+{
+	const GF_PropertyValue *p;
+	u32 i;
+	GF_BaseFilter *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
+	for (i=0; i<stack->nb_level_pids; i++)
+		if (stack->level_pids[i] == pid) break;
+	if (stack->dst_pid != pid && i == stack->nb_level_pids) return GF_BAD_PARAM;
+
+	//downstream asks for another pixel format, switch kernels if we produce it
+	p = gf_filter_pid_caps_query(pid, GF_PROP_PID_PIXFMT);
+	if (!p) return GF_OK;
+	if (stack->packed || !GetPixelSize(p->value.uint)) return GF_NOT_SUPPORTED;
+	//scaled frames and previews have no chroma subsampling; regions set while running replace the preview
+	if ((BMP1BPP_scales_frames(stack) || (stack->preview && !stack->nb_rois)) && (p->value.uint == GF_PIXEL_YUV || p->value.uint == GF_PIXEL_NV12)) return GF_NOT_SUPPORTED;
+	//pyramid levels average whole bytes, and all levels share the format
+	if (stack->pyramid && (p->value.uint == GF_PIXEL_YUV || p->value.uint == GF_PIXEL_NV12 || p->value.uint == GF_PIXEL_RGB_565)) return GF_NOT_SUPPORTED;
 
+	stack->pfmt = p->value.uint;
+	gf_filter_pid_set_property(stack->dst_pid, GF_PROP_PID_PIXFMT, &PROP_UINT(stack->pfmt));
+	for (i=0; i<stack->nb_level_pids; i++)
+		gf_filter_pid_set_property(stack->level_pids[i], GF_PROP_PID_PIXFMT, &PROP_UINT(stack->pfmt));
 	return GF_OK;
 }
 
 static GF_Err base_filter_update_arg(GF_Filter *filter, const char *arg_name, const GF_PropertyValue *arg_val)
 {
+	GF_BaseFilter *stack = (GF_BaseFilter *) gf_filter_get_udta(filter);
+
+	//new regions apply from the next image on
+	if (!strcmp(arg_name, "roi")) {
+		if (stack->stream || stack->packed || stack->pyramid) return GF_NOT_FOUND;
+		if (BMP1BPP_scales_frames(stack) && arg_val->value.string_list.nb_items) {
+			GF_LOG(GF_LOG_ERROR, GF_LOG_CODEC, ("[BMP1BPP] osize, downscale and upscale scale whole frames, regions of interest cannot be set\n"));
+			return GF_BAD_PARAM;
+		}
+		return BMP1BPP_set_rois(stack, &arg_val->value.string_list);
+	}
 	return GF_OK;
+}
 
-	
+/* GPAC config section of the tuned profile */
+#define BMP1BPP_PROFILE_SECTION	"BMP1BPP"
+
+/* band size when it is neither set nor tuned */
+#define BMP1BPP_BAND_PIXELS	262144
+
+enum
+{
+	BMP1BPP_KERNEL_AUTO = 0,
+	BMP1BPP_KERNEL_SCALAR,
+	BMP1BPP_KERNEL_SSE2,
+	BMP1BPP_KERNEL_AVX2,
+	BMP1BPP_KERNEL_NEON,
+	BMP1BPP_KERNEL_SIMD128,
+};
+
+//kernel set of each kernel option value, as named in KernelSets
+static const char *BMP1BPPKernelNames[] = { "auto", "scalar", "sse2", "avx2", "neon", "simd128" };
+
+//kernel profile shared by the instances of the process, loaded or benchmarked by the first instance in auto mode
+static struct BMP_Profile ProcessProfile;
+//the kernels of ProcessProfile were benchmarked by this process, retune does not benchmark them again
+static Bool ProcessProfileBenchmarked = GF_FALSE;
+
+//reads the profile saved by an earlier run, the kernels only if all their sets exist in this build and CPU
+static void BMP1BPP_load_profile(struct BMP_Profile *profile)
+{
+	const char *names = gf_opts_get_key(BMP1BPP_PROFILE_SECTION, "kernels");
+	const char *bandpix = gf_opts_get_key(BMP1BPP_PROFILE_SECTION, "bandpix");
+	u32 p, s, len;
+
+	if (bandpix) profile->BandPixels = (UINT) strtoul(bandpix, NULL, 10);
+	if (!names) return;
+
+	//one kernel set name per number of bytes per source pixel, 1 to 4
+	for (p = 1; p <= 4; p++) {
+		len = (u32) strcspn(names, ",");
+		for (s = 0; s < NbKernelSets; s++) {
+			if (strlen(KernelSets[s].Name) == len && !strncmp(KernelSets[s].Name, names, len)) break;
+		}
+		if (s == NbKernelSets) return;
+		profile->KernelSet[p] = s;
+		names += len;
+		if (*names == ',') names++;
+		else if (p < 4) return;
+	}
+	profile->Tuned = GF_TRUE;
+}
+
+//saves the profile in the GPAC config, written back when the session ends
+static void BMP1BPP_save_profile(const struct BMP_Profile *profile)
+{
+	char value[64];
+
+	snprintf(value, sizeof(value), "%s,%s,%s,%s", KernelSets[profile->KernelSet[1]].Name, KernelSets[profile->KernelSet[2]].Name,
+		KernelSets[profile->KernelSet[3]].Name, KernelSets[profile->KernelSet[4]].Name);
+	gf_opts_set_key(BMP1BPP_PROFILE_SECTION, "kernels", value);
+	if (profile->BandPixels) {
+		snprintf(value, sizeof(value), "%u", (u32) profile->BandPixels);
+		gf_opts_set_key(BMP1BPP_PROFILE_SECTION, "bandpix", value);
+	}
 }
 
 GF_Err base_filter_initialize(GF_Filter *filter)
 {
 	GF_BaseFilter *stack = gf_filter_get_udta(filter);
-	if (stack->opt2) {
-		//do something based on options
 
+	u32 nb_threads = stack->threads;
+	struct BMP_Profile profile;
+	Bool save = GF_FALSE;
+	u32 p, s;
+
+	if (!GetPixelSize(stack->pfmt)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] pixel format %s not supported, using rgb\n", gf_pixel_fmt_name(stack->pfmt)));
+		stack->pfmt = GF_PIXEL_RGB;
 	}
-	//if your filter is a source, this is the right place to start declaring output PIDs, such as above
+
+	if (stack->stream && (stack->lazy || stack->packed)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] stream mode decodes rows as they arrive, ignoring lazy and packed\n"));
+		stack->lazy = stack->packed = GF_FALSE;
+	}
+	if ((stack->tile.x || stack->tile.y) && (stack->tile.x <= 0 || stack->tile.y <= 0 || stack->stream || stack->packed)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] tile mode needs a positive tile size and expanded framed input, ignoring it\n"));
+		stack->tile.x = stack->tile.y = 0;
+	}
+	if (stack->strip && stack->tile.x) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] tile mode set, ignoring strip mode\n"));
+		stack->strip = 0;
+	}
+	if (stack->downscale != 1 && stack->downscale != 2 && stack->downscale != 4 && stack->downscale != 8) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] downscale must be 1, 2, 4 or 8, not downscaling\n"));
+		stack->downscale = 1;
+	}
+	if (stack->downscale > 1 && (stack->stream || stack->packed || stack->pfmt == GF_PIXEL_YUV || stack->pfmt == GF_PIXEL_NV12)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] downscale needs expanded framed input and an RGB or grey pixel format, not downscaling\n"));
+		stack->downscale = 1;
+	}
+	if (stack->upscale < 1 || stack->upscale > BMP_MAX_ZOOM) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] upscale must be 1 to %d, not upscaling\n", BMP_MAX_ZOOM));
+		stack->upscale = 1;
+	}
+	if (stack->upscale > 1 && (stack->downscale > 1 || stack->stream || stack->packed || stack->pfmt == GF_PIXEL_YUV || stack->pfmt == GF_PIXEL_NV12)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] upscale needs expanded framed input, an RGB or grey pixel format and no downscale, not upscaling\n"));
+		stack->upscale = 1;
+	}
+	if ((stack->osize.x || stack->osize.y) && (stack->osize.x <= 0 || stack->osize.y <= 0 || stack->stream || stack->packed || stack->pfmt == GF_PIXEL_YUV || stack->pfmt == GF_PIXEL_NV12)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] osize needs a positive size, expanded framed input and an RGB or grey pixel format, not resampling\n"));
+		stack->osize.x = stack->osize.y = 0;
+	}
+	if (stack->osize.x && (stack->downscale > 1 || stack->upscale > 1)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] osize set, ignoring downscale and upscale\n"));
+		stack->downscale = stack->upscale = 1;
+	}
+	if (stack->pyramid && (stack->stream || stack->packed || stack->lazy || stack->pfmt == GF_PIXEL_YUV || stack->pfmt == GF_PIXEL_NV12 || stack->pfmt == GF_PIXEL_RGB_565)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] pyramid needs expanded framed input, no lazy frames and an 8-bit per channel pixel format, no pyramid\n"));
+		stack->pyramid = 0;
+	}
+	if (stack->pyramid && (stack->osize.x || stack->downscale > 1 || stack->upscale > 1 || stack->strip || stack->tile.x)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] pyramid set, ignoring osize, downscale, upscale, strip and tile\n"));
+		stack->osize.x = stack->osize.y = 0;
+		stack->downscale = stack->upscale = 1;
+		stack->strip = 0;
+		stack->tile.x = stack->tile.y = 0;
+	}
+	//scaled frames are whole frames, there is no scaled region, tile or strip
+	if (BMP1BPP_scales_frames(stack) && (stack->strip || stack->tile.x || stack->roi.nb_items)) {
+		GF_LOG(GF_LOG_ERROR, GF_LOG_CODEC, ("[BMP1BPP] osize, downscale and upscale scale whole frames and cannot be combined with strip, tile or roi\n"));
+		return GF_BAD_PARAM;
+	}
+	if (stack->preview == 1) stack->preview = 0;
+	if (stack->preview && (stack->stream || stack->packed || stack->pfmt == GF_PIXEL_YUV || stack->pfmt == GF_PIXEL_NV12)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] preview needs expanded framed input and an RGB or grey pixel format, no preview\n"));
+		stack->preview = 0;
+	}
+	if (stack->preview && (stack->osize.x || stack->downscale > 1 || stack->upscale > 1 || stack->pyramid || stack->strip || stack->tile.x || stack->roi.nb_items)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] preview only applies to full-size whole frames, no preview\n"));
+		stack->preview = 0;
+	}
+	if (stack->roi.nb_items && (stack->stream || stack->packed || stack->pyramid)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] regions of interest need expanded framed input and no pyramid, ignoring them\n"));
+	} else if (BMP1BPP_set_rois(stack, &stack->roi) != GF_OK) {
+		return GF_BAD_PARAM;
+	}
+	if (stack->strip && (stack->stream || stack->packed)) {
+		GF_LOG(GF_LOG_WARNING, GF_LOG_CODEC, ("[BMP1BPP] strip mode only applies to expanded framed input, ignoring it\n"));
+		stack->strip = 0;
+	}
+
+	/* frames can be released, and lazy frames decoded, from other threads */
+	stack->bmp.Stats.Mutex = gf_mx_new("BMP1BPP alloc");
+	if (stack->lazy)
+		stack->lazy_mutex = gf_mx_new("BMP1BPP lazy");
+
+	/* row kernels: forced, or the fastest on this machine, benchmarked once per process and saved */
+	memset(&profile, 0, sizeof(profile));
+	InitKernelSets();
+	if (stack->kernel != BMP1BPP_KERNEL_AUTO) {
+		const char *name = (stack->kernel <= BMP1BPP_KERNEL_SIMD128) ? BMP1BPPKernelNames[stack->kernel] : "unknown";
+		for (s = 0; s < NbKernelSets; s++) {
+			if (!strcmp(KernelSets[s].Name, name)) break;
+		}
+		if (s == NbKernelSets) {
+			GF_LOG(GF_LOG_ERROR, GF_LOG_CODEC, ("[BMP1BPP] %s kernels are not available in this build or on this CPU\n", name));
+			return GF_NOT_SUPPORTED;
+		}
+		for (p = 1; p <= 4; p++) profile.KernelSet[p] = s;
+	} else {
+		gf_mx_p(ProfileMutex);
+		if (!ProcessProfile.Tuned && !stack->retune) BMP1BPP_load_profile(&ProcessProfile);
+		if (!ProcessProfileBenchmarked && (!ProcessProfile.Tuned || stack->retune)) {
+			struct BMP_Profile tuned;
+			memset(&tuned, 0, sizeof(tuned));
+			if (TuneExpandKernels(&tuned, &stack->bmp.Stats)) {
+				//the band size was measured with the previous kernels
+				ProcessProfile = tuned;
+				ProcessProfileBenchmarked = GF_TRUE;
+				save = GF_TRUE;
+			}
+		}
+		profile = ProcessProfile;
+		gf_mx_v(ProfileMutex);
+	}
+	SetExpandKernels(&stack->bmp.Kernels, profile.KernelSet);
+	stack->bmp.Expand.Kernels = &stack->bmp.Kernels;
+
+	/* 0 means one decode thread per core, the calling thread being one of them */
+	if (!nb_threads) {
+		GF_SystemRTInfo rti;
+		memset(&rti, 0, sizeof(rti));
+		gf_sys_get_rti(0, &rti, 0);
+		nb_threads = rti.nb_cores ? rti.nb_cores : 1;
+	}
+	if (nb_threads > 1) {
+		stack->pool = WorkerPool_New(nb_threads - 1, stack->bandpix ? stack->bandpix : (profile.BandPixels ? profile.BandPixels : BMP1BPP_BAND_PIXELS), &stack->bmp.Stats);
+		//the band size is tuned for the tuned kernels only, by the first instance with a pool
+		if (stack->pool && !stack->bandpix && profile.Tuned && !profile.BandPixels) {
+			gf_mx_p(ProfileMutex);
+			if (!ProcessProfile.BandPixels) {
+				ProcessProfile.BandPixels = WorkerPool_Tune(stack->pool, &stack->bmp.Kernels, &stack->bmp.Stats);
+				if (ProcessProfile.BandPixels) save = GF_TRUE;
+			}
+			profile.BandPixels = ProcessProfile.BandPixels;
+			gf_mx_v(ProfileMutex);
+			if (profile.BandPixels)
+				stack->pool->MinBandPixels = profile.BandPixels;
+		}
+	}
+	if (save) {
+		gf_mx_p(ProfileMutex);
+		BMP1BPP_save_profile(&ProcessProfile);
+		gf_mx_v(ProfileMutex);
+	}
+
+	FramePool_Init(&stack->frames, stack->nbframes, &stack->bmp.Stats);
 
 
 	return GF_OK;
 }
 
 #define OFFS(_n)	#_n, offsetof(GF_BaseFilter, _n)
-static const GF_FilterArgs ExampleFilterArgs[] =
+static const GF_FilterArgs BMP1BPPFilterArgs[] =
 {
-	//example uint option using enum, result parsed ranges from 0(=v1) to 2(=v3)
-	{ OFFS(opt1), "Example option 1", GF_PROP_UINT, "v1", "v1|v2|v3", 0},
-	{ OFFS(opt2), "Example option 2", GF_PROP_BOOL, "false", NULL, 0},
+	{ OFFS(pfmt), "output pixel format, one of rgb, bgr, rgba, rgbx, grey, rgb565, yuv or nv12 - may be changed by format negotiation", GF_PROP_PIXFMT, "rgb", NULL, 0},
+	{ OFFS(threads), "number of decode threads, 0 meaning one per core", GF_PROP_UINT, "0", NULL, GF_FS_ARG_HINT_EXPERT},
+	{ OFFS(bandpix), "minimum number of pixels in a band of rows decoded by one thread, 0 for the tuned value - see filter help", GF_PROP_UINT, "0", NULL, GF_FS_ARG_HINT_EXPERT},
+	{ OFFS(kernel), "row expansion kernels - see filter help\n"
+	"- auto: fastest on this machine, from the saved profile\n"
+	"- scalar: portable C kernels\n"
+	"- sse2: x86 SSE2 kernels\n"
+	"- avx2: x86 AVX2 kernels\n"
+	"- neon: ARM NEON kernels\n"
+	"- simd128: WebAssembly SIMD kernels", GF_PROP_UINT, "auto", "auto|scalar|sse2|avx2|neon|simd128", GF_FS_ARG_HINT_EXPERT},
+	{ OFFS(retune), "benchmark the kernels again instead of using the saved profile, unless this process already did", GF_PROP_BOOL, "false", NULL, GF_FS_ARG_HINT_EXPERT},
+	{ OFFS(nbframes), "maximum number of output frames recycled across packets, 0 to allocate every frame", GF_PROP_UINT, "4", NULL, GF_FS_ARG_HINT_EXPERT},
+	{ OFFS(lazy), "output frames through a frame interface and only expand them when a consumer first reads them", GF_PROP_BOOL, "false", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(packed), "output the 1-bit pixels packed as in the file, top-down, with the colors in the `bmp_palette` property - see filter help", GF_PROP_BOOL, "false", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(stream), "decode unframed input incrementally, buffering only the header and a couple of rows instead of the whole file - see filter help", GF_PROP_BOOL, "false", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(strip), "output the image as packets of at most this many rows, 0 for whole frames - see filter help", GF_PROP_UINT, "0", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(tile), "output the image as tiles of this size, 0x0 for whole frames - see filter help", GF_PROP_VEC2I, "0x0", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(roi), "regions of interest, each given as WxH+X+Y; only these regions are decoded and output - see filter help", GF_PROP_STRING_LIST, NULL, NULL, GF_FS_ARG_HINT_ADVANCED|GF_FS_ARG_UPDATE},
+	{ OFFS(downscale), "output frames downscaled by 2, 4 or 8, each pixel shading the colors by the share of each in its block - see filter help", GF_PROP_UINT, "1", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(upscale), "output frames upscaled by this integer factor, up to 4, each source pixel giving a square block - see filter help", GF_PROP_UINT, "1", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(osize), "output frames resampled to this size, each pixel shading the colors by the share of each in the area it covers - see filter help", GF_PROP_VEC2I, "0x0", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(pyramid), "output a pyramid of frames halved down to this size, one PID per level - see filter help", GF_PROP_UINT, "0", NULL, GF_FS_ARG_HINT_ADVANCED},
+	{ OFFS(preview), "send a preview sampled every this many pixels before each full frame - see filter help", GF_PROP_UINT, "0", NULL, GF_FS_ARG_HINT_ADVANCED},
 	{ NULL }
 };
 
@@ -677,6 +4326,15 @@ static const GF_FilterCapability BMP1BPPFullCaps[] =
 	CAP_STRING(GF_CAPS_INPUT, GF_PROP_PID_MIME, "image/bmp"),
 	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_STREAM_TYPE, GF_STREAM_VISUAL),
 	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_CODECID, GF_CODECID_RAW),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_RGB),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_BGR),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_RGBA),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_RGBX),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_GREYSCALE),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_RGB_565),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_YUV),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, GF_PIXEL_NV12),
+	CAP_UINT(GF_CAPS_OUTPUT, GF_PROP_PID_PIXFMT, BMP_PIXEL_PACKED1),
 };
 
 
@@ -685,14 +4343,79 @@ static const GF_FilterCapability BMP1BPPFullCaps[] =
 const GF_FilterRegister BMP1BPPRegister = {
 	.name = "BMP1BPP",
 	GF_FS_SET_DESCRIPTION("BMP 1BPP")
-	GF_FS_SET_HELP("Accessor filter for BMP 1BPP images.")
+	GF_FS_SET_HELP("Accessor filter for BMP 1BPP images.\n"
+	"\n"
+	"In `packed` mode the pixels are not expanded. Output frames use pixel format `BPK1`: rows are top-down, "
+	"`Stride` bytes apart, with 8 pixels per byte, the first pixel in the most significant bit (PID property `bmp_bitorder` set to `msb`). "
+	"The PID property `bmp_palette` holds the RGB values of colors 0 and 1 (6 bytes). Top-down images are forwarded without any copy.\n"
+	"\n"
+	"In `stream` mode the input is not reassembled into whole files: rows are expanded into the output frame as their bytes arrive, "
+	"and the frame is sent once its last row is decoded. Input memory stays bounded by the header and two rows. "
+	"A truncated image is dropped. The `lazy` and `packed` options are ignored in this mode.\n"
+	"\n"
+	"In `strip` mode every image is sent as several packets of at most `strip` rows (rounded up to even for YUV), top strip first. "
+	"The PID `Height` is the strip height; the last strip of an image has packet property `bmp_strip_height` giving its own, which may be less. PID properties `bmp_full_width` and `bmp_full_height` give the image size, "
+	"packet properties `bmp_strip_y` the first image row of the strip and `bmp_strip_offset` its 64-bit byte offset in plane 0 of the full image. "
+	"The first and last strips of an image are flagged as frame start and end. Images whose frame exceeds 4 GB can only be output in this mode. "
+	"Strips are not available in `stream` or `packed` mode.\n"
+	"\n"
+	"In `tile` mode every image is sent as tiles of the given size (smaller on the right and bottom edges), row by row, left to right. "
+	"Each tile is decoded on its own straight from the source bits, tiles not starting on a byte boundary being realigned on the fly, "
+	"and the tiles of a row are decoded in parallel. The PID `Width`, `Height` and `Stride` follow the tile size. "
+	"PID properties `bmp_full_width`, `bmp_full_height`, `bmp_tile_cols` and `bmp_tile_rows` describe the grid, "
+	"packet properties `bmp_tile_id` (row-major index), `bmp_tile_x` and `bmp_tile_y` locate each tile. "
+	"Combined with `lazy`, a tile is only expanded when a consumer reads it. Tile mode takes precedence over `strip`.\n"
+	"\n"
+	"When `roi` lists regions of interest, only these rectangles are output, one packet each in list order, clipped to the image. "
+	"Only the source bytes covering them are read, at any horizontal bit offset, and all regions of an image share a single header parse. "
+	"Packets carry `bmp_roi_id` (index in the list), `bmp_roi_x` and `bmp_roi_y`, the PID geometry following the region size. "
+	"The option can be changed while running, new regions apply from the next image. It takes precedence over `tile` and `strip`.\n"
+	"\n"
+	"With `downscale` set to 2, 4 or 8, whole frames are output at that fraction of the image size (rounded up), antialiased: "
+	"each pixel mixes the two colors by the number of color 1 pixels in its block, counted straight from the packed bits, "
+	"so the full-size image is never expanded. Downscaled frames use RGB or grey formats, not YUV, "
+	"and downscale does not apply with `stream` or `packed`. It cannot be set along with `roi`, `tile` or `strip`, the filter then fails to start.\n"
+	"\n"
+	"With `upscale` set to 2, 3 or 4, whole frames are output that many times larger with nearest-neighbour blocks, written while expanding: "
+	"the expansion tables hold each pixel repeated horizontally, and each expanded row is copied to the rows below it. "
+	"The same restrictions as for `downscale` apply, and both cannot be set at once.\n"
+	"\n"
+	"With `osize` set, e.g. to 1240x1754, whole frames are resampled to exactly that size, smaller or larger: "
+	"each pixel gets one of 256 shades between the two colors, from the share of color 1 in the source area it covers, "
+	"counted from the packed bits without a full-size intermediate. The same restrictions as for `downscale` apply, "
+	"and `osize` takes precedence over `downscale` and `upscale`.\n"
+	"\n"
+	"With `pyramid` set to a size, e.g. 256, each image is output at full size and halved (rounded up) until both sides fit in that size, "
+	"every level on its own output PID carrying `bmp_pyramid_level` (the full-size PID has none). "
+	"The level PIDs are declared with the output, as many as the `Width` and `Height` of the input PID need, or 24 when the input does not give them; "
+	"the levels an image is too small for are sent end of stream until an image needs them again. The levels are built in the same pass as the full frame: "
+	"as soon as two rows of a level are written they are averaged 2x2 into the next level, while they are still in cache. "
+	"Pyramids use 8-bit per channel formats (not 565 or YUV), do not apply with `stream`, `packed` or `lazy`, "
+	"and take precedence over `osize`, `downscale`, `upscale`, `roi`, `tile` and `strip`.\n"
+	"\n"
+	"With `preview` set to N (2 or more), each image is first sent as a preview of 1/N its size (rounded up) "
+	"made of one pixel in N of one row in N, so only that share of the source rows is read, then as the full frame, both on the same PID. "
+	"Packets carry `bmp_quality`, 0 for the preview and 1 for the full frame, and the PID `Width`, `Height` and `Stride` "
+	"change to the preview's for the preview packet only. The full frame can be lazy. "
+	"Previews use RGB or grey formats, not YUV, and only apply to full-size whole frames: "
+	"not with `stream`, `packed`, `osize`, `downscale`, `upscale`, `pyramid`, `roi`, `tile` or `strip`.\n"
+	"\n"
+	"Rows are expanded by scalar or vector kernels (SSE2, AVX2, NEON or WebAssembly SIMD, depending on the build and CPU). "
+	"A set forced by `kernel` that the build or CPU lacks is refused and the filter fails to initialize. "
+	"With `kernel` set to `auto`, the first run benchmarks every kernel set on synthetic rows for each output pixel size, "
+	"and with several threads measures the band size worth handing to another thread. "
+	"The result is saved in the `BMP1BPP` section of the GPAC config file and reused by later runs, "
+	"until `retune` is set or the saved kernels are not available. The benchmark runs at most once per process, "
+	"later instances share its result. A `bandpix` other than 0 overrides the tuned band size.")
 	.private_size = sizeof(GF_BaseFilter),
-	.args = NULL,
+	.args = BMP1BPPFilterArgs,
+	.update_arg = base_filter_update_arg,
 	.initialize = base_filter_initialize,
 	.finalize = base_filter_finalize,
 	SETCAPS(BMP1BPPFullCaps),
 	.process = BMP1BPP_filter_process,
 	.configure_pid = BMP1BPP_filter_config_input,
+	.reconfigure_output = BMP1BPP_reconfigure_output,
 	.probe_data = BMP1BPP_probe_data
 	
 };
@@ -0,0 +1,127 @@
+/*
+ * Every output pixel format, eager and lazy, must match the reference
+ * decode pixel for pixel, and so must a format switched to by
+ * negotiation after the first frame.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	5
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 7, 3, GF_TRUE }, { 100, 37, GF_FALSE }, { 257, 64, GF_TRUE }, { 1024, 9, GF_FALSE },
+};
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "bgr", GF_PIXEL_BGR }, { "rgba", GF_PIXEL_RGBA }, { "rgbx", GF_PIXEL_RGBX },
+	{ "grey", GF_PIXEL_GREYSCALE }, { "rgb565", GF_PIXEL_RGB_565 }, { "yuv", GF_PIXEL_YUV }, { "nv12", GF_PIXEL_NV12 },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+/* decodes every image once, then checks the PID and each frame */
+static u32 check(GF_Filter *filter, const char *what, u32 pfmt)
+{
+	u32 i, nb_errors = 0;
+	const GF_PropertyValue *p;
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		HostOutput out;
+		u32 size;
+		u8 *expected = ref_expand(&refs[i], pfmt, &size);
+
+		memset(&out, 0, sizeof(out));
+		host_filter_push(filter, bmps[i], bmp_sizes[i]);
+		if (host_filter_run(filter, &out) != GF_OK) {
+			fprintf(stderr, "%s: image %u not decoded\n", what, i);
+			nb_errors++;
+		} else if (out.size != size || memcmp(out.data, expected, size)) {
+			fprintf(stderr, "%s: image %u differs from the reference\n", what, i);
+			nb_errors++;
+		}
+		p = host_filter_pid_property(filter, 0, GF_PROP_PID_STRIDE);
+		if (!p || p->value.uint != refs[i].width * ref_pixel_size(pfmt)) {
+			fprintf(stderr, "%s: image %u has the wrong stride\n", what, i);
+			nb_errors++;
+		}
+		if (pfmt == GF_PIXEL_YUV || pfmt == GF_PIXEL_NV12) {
+			p = host_filter_pid_property(filter, 0, GF_PROP_PID_STRIDE_UV);
+			if (!p || p->value.uint != (pfmt == GF_PIXEL_NV12 ? 2 : 1) * ((refs[i].width + 1) / 2)) {
+				fprintf(stderr, "%s: image %u has the wrong chroma stride\n", what, i);
+				nb_errors++;
+			}
+		}
+		host_output_reset(&out);
+		free(expected);
+	}
+	p = host_filter_pid_property(filter, 0, GF_PROP_PID_PIXFMT);
+	if (!p || p->value.uint != pfmt) {
+		fprintf(stderr, "%s: wrong pixel format on the PID\n", what);
+		nb_errors++;
+	}
+	return nb_errors;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, lazy, nb_errors = 0;
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 100 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			char args[64], what[160];
+			GF_Filter *filter;
+			u32 to = formats[(f + 1) % NB_FORMATS].pfmt;
+
+			snprintf(args, sizeof(args), "pfmt=%s:lazy=%s", formats[f].name, lazy ? "true" : "false");
+			filter = host_filter_new(&BMP1BPPRegister, args);
+			if (!filter) {
+				fprintf(stderr, "%s: cannot create the filter\n", args);
+				return 1;
+			}
+			nb_errors += check(filter, args, formats[f].pfmt);
+
+			/* downstream then asks for the next format */
+			snprintf(what, sizeof(what), "%s then %s", args, formats[(f + 1) % NB_FORMATS].name);
+			if (host_filter_reconfigure(filter, to) != GF_OK) {
+				fprintf(stderr, "%s: negotiation refused\n", what);
+				nb_errors++;
+			} else {
+				nb_errors += check(filter, what, to);
+			}
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+		}
+	}
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u checks failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u formats, eager and lazy, match the reference\n", (u32) NB_FORMATS);
+	return 0;
+}
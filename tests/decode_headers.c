@@ -0,0 +1,194 @@
+/*
+ * Every supported DIB header (12-byte core, 40, 52, 56, 108 and 124-byte
+ * info headers) must decode as the reference does, whatever the palette
+ * gap, and images the filter cannot decode must be rejected with nothing
+ * sent, framed or streamed, without upsetting the image that follows.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+typedef struct
+{
+	const char *name;
+	u32 header_size;
+	u32 w, h;
+	Bool top_down;
+	/* palette entries written, only the first two are used */
+	u32 nb_colors;
+} Variant;
+
+static const Variant variants[] = {
+	{ "core", 12, 33, 9, GF_FALSE, 2 },
+	{ "core, wide", 12, 40000, 2, GF_FALSE, 2 },
+	{ "info", 40, 100, 37, GF_FALSE, 2 },
+	{ "info, top-down", 40, 100, 37, GF_TRUE, 2 },
+	{ "info, 16 colors", 40, 65, 3, GF_FALSE, 16 },
+	{ "v2", 52, 31, 8, GF_TRUE, 2 },
+	{ "v3", 56, 64, 5, GF_FALSE, 2 },
+	{ "v4", 108, 7, 70, GF_TRUE, 2 },
+	{ "v5", 124, 129, 17, GF_FALSE, 3 },
+};
+#define NB_VARIANTS	(sizeof(variants) / sizeof(variants[0]))
+
+static void put_le(u8 *p, u32 v, u32 n)
+{
+	u32 i;
+	for (i = 0; i < n; i++) p[i] = (u8) (v >> (8 * i));
+}
+
+/* a BMP of variant v with random pixels and palette, and its reference */
+static u8 *make_bmp(const Variant *v, u32 seed, u32 *size, RefImage *ref)
+{
+	u32 stride = ((v->w + 31) / 32) * 4, entry = (v->header_size == 12) ? 3 : 4;
+	u32 offset = 14 + v->header_size + v->nb_colors * entry, x, y, i;
+	u8 *bmp;
+
+	*size = offset + stride * v->h;
+	bmp = calloc(1, *size);
+	bmp[0] = 'B';
+	bmp[1] = 'M';
+	put_le(bmp + 2, *size, 4);
+	put_le(bmp + 10, offset, 4);
+	put_le(bmp + 14, v->header_size, 4);
+	if (v->header_size == 12) {
+		put_le(bmp + 18, v->w, 2);
+		put_le(bmp + 20, v->h, 2);
+		put_le(bmp + 22, 1, 2);
+		put_le(bmp + 24, 1, 2);
+	} else {
+		put_le(bmp + 18, v->w, 4);
+		put_le(bmp + 22, v->top_down ? (u32) -(s32) v->h : v->h, 4);
+		put_le(bmp + 26, 1, 2);
+		put_le(bmp + 28, 1, 2);
+		put_le(bmp + 34, stride * v->h, 4);
+		put_le(bmp + 46, v->nb_colors, 4);
+	}
+	for (i = 14 + v->header_size; i < *size; i++) {
+		seed = seed * 1103515245 + 12345;
+		bmp[i] = (u8) (seed >> 16);
+	}
+
+	ref->width = v->w;
+	ref->height = v->h;
+	for (i = 0; i < 2; i++) {
+		const u8 *p = bmp + 14 + v->header_size + i * entry;
+		ref->color[i][0] = p[2];
+		ref->color[i][1] = p[1];
+		ref->color[i][2] = p[0];
+	}
+	ref->index = malloc(v->w * v->h);
+	for (y = 0; y < v->h; y++) {
+		const u8 *row = bmp + offset + (v->top_down ? y : v->h - 1 - y) * stride;
+		for (x = 0; x < v->w; x++)
+			ref->index[y * v->w + x] = (row[x / 8] >> (7 - x % 8)) & 1;
+	}
+	return bmp;
+}
+
+/* changes made to a valid 40-byte header image, each making it one the filter must reject */
+static void bad_magic(u8 *bmp, u32 *size) { bmp[0] = 'X'; }
+static void bad_header_size(u8 *bmp, u32 *size) { put_le(bmp + 14, 64, 4); }
+static void bad_depth(u8 *bmp, u32 *size) { put_le(bmp + 28, 24, 2); }
+static void bad_offset(u8 *bmp, u32 *size) { put_le(bmp + 10, 40, 4); }
+static void bad_compression(u8 *bmp, u32 *size) { put_le(bmp + 30, 1, 4); put_le(bmp + 34, 1, 4); }
+static void short_pixels(u8 *bmp, u32 *size) { *size -= 5; }
+/* ends before the compression field */
+static void short_header(u8 *bmp, u32 *size) { *size = 30; }
+static void zero_width(u8 *bmp, u32 *size) { put_le(bmp + 18, 0, 4); }
+static void zero_height(u8 *bmp, u32 *size) { put_le(bmp + 22, 0, 4); }
+static void int_min_height(u8 *bmp, u32 *size) { put_le(bmp + 22, 0x80000000, 4); }
+
+static const struct
+{
+	const char *name;
+	void (*spoil)(u8 *bmp, u32 *size);
+} bad[] = {
+	{ "bad magic", bad_magic },
+	{ "unknown header size", bad_header_size },
+	{ "24 bits per pixel", bad_depth },
+	{ "data offset inside the header", bad_offset },
+	{ "compressed with a wrong data size", bad_compression },
+	{ "pixels cut short", short_pixels },
+	{ "the DIB header cut short", short_header },
+	{ "a zero width", zero_width },
+	{ "a zero height", zero_height },
+	{ "a height of -2^31", int_min_height },
+};
+#define NB_BAD	(sizeof(bad) / sizeof(bad[0]))
+
+/* in stream mode, a bad image is dropped without an error */
+static const char *configs[] = { "pfmt=rgb", "pfmt=rgb:lazy=true", "pfmt=rgb:stream=true" };
+#define NB_CONFIGS	(sizeof(configs) / sizeof(configs[0]))
+
+int main(int argc, char **argv)
+{
+	u32 i, o, nb_errors = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (o = 0; o < NB_CONFIGS; o++) {
+		Bool stream = (strstr(configs[o], "stream") != NULL);
+		GF_Filter *filter = host_filter_new(&BMP1BPPRegister, configs[o]);
+		if (!filter) {
+			fprintf(stderr, "%s: cannot create the filter\n", configs[o]);
+			return 1;
+		}
+
+		for (i = 0; i < NB_VARIANTS; i++) {
+			RefImage ref;
+			u32 bmp_size, size;
+			u8 *bmp = make_bmp(&variants[i], 1200 + i, &bmp_size, &ref);
+			u8 *expected = ref_expand(&ref, GF_PIXEL_RGB, &size);
+
+			host_output_clear(&out);
+			host_filter_push(filter, bmp, bmp_size);
+			if (host_filter_run(filter, &out) != GF_OK) {
+				fprintf(stderr, "%s: %s header not decoded\n", configs[o], variants[i].name);
+				nb_errors++;
+			} else if (out.size != size || memcmp(out.data, expected, size)) {
+				fprintf(stderr, "%s: %s header decodes differently from the reference\n", configs[o], variants[i].name);
+				nb_errors++;
+			}
+			free(expected);
+			ref_free(&ref);
+			free(bmp);
+		}
+
+		/* a valid image between bad ones, so that no state is carried over */
+		for (i = 0; i < 2 * NB_BAD; i++) {
+			RefImage ref;
+			u32 bmp_size;
+			u8 *bmp = make_bmp(&variants[2], 1300 + i, &bmp_size, &ref);
+			GF_Err e;
+
+			if (i % 2 == 0) bad[i / 2].spoil(bmp, &bmp_size);
+			host_output_clear(&out);
+			host_filter_push(filter, bmp, bmp_size);
+			e = host_filter_run(filter, &out);
+			if (i % 2 == 0 && ((e == GF_OK && !stream) || out.nb_packets)) {
+				fprintf(stderr, "%s: image with %s not rejected\n", configs[o], bad[i / 2].name);
+				nb_errors++;
+			} else if (i % 2 == 1 && (e != GF_OK || out.nb_packets != 1)) {
+				fprintf(stderr, "%s: valid image after one with %s not decoded\n", configs[o], bad[i / 2].name);
+				nb_errors++;
+			}
+			ref_free(&ref);
+			free(bmp);
+		}
+		host_filter_finalize(filter);
+		host_filter_free(filter);
+	}
+
+	host_output_reset(&out);
+	if (nb_errors) {
+		fprintf(stderr, "%u checks failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u header variants decoded, %u bad images rejected\n", (u32) NB_VARIANTS, (u32) NB_BAD);
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Packed mode: every image must come out as its 1-bit rows, top row first,
+ * with the two palette colors in bmp_palette. The PID is only set again
+ * when something changes, the palette included.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	5
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+	u32 seed;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE, 1 }, { 33, 7, GF_TRUE, 2 }, { 100, 37, GF_FALSE, 3 },
+	/* same size as the previous one, another palette */
+	{ 100, 37, GF_FALSE, 4 }, { 640, 480, GF_TRUE, 4 },
+};
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+static u32 check_image(GF_Filter *filter, u32 image, const HostOutput *out)
+{
+	const RefImage *ref = &refs[image];
+	const GF_PropertyValue *p;
+	u32 stride = (ref->width + 31) / 32 * 4, x, y;
+
+	if (out->nb_packets != 1 || out->size != stride * ref->height) {
+		fprintf(stderr, "image %u: %u packets of %u bytes\n", image, out->nb_packets, out->size);
+		return 1;
+	}
+	p = host_filter_pid_property(filter, 0, GF_PROP_PID_STRIDE);
+	if (!p || p->value.uint != stride) {
+		fprintf(stderr, "image %u: wrong stride\n", image);
+		return 1;
+	}
+	p = host_filter_pid_property_str(filter, 0, "bmp_palette");
+	if (!p || p->type != GF_PROP_DATA || p->value.data.size != 6 || memcmp(p->value.data.ptr, ref->color, 6)) {
+		fprintf(stderr, "image %u: wrong bmp_palette\n", image);
+		return 1;
+	}
+	/* the row padding is left as it is in the file */
+	for (y = 0; y < ref->height; y++) {
+		for (x = 0; x < ref->width; x++) {
+			u32 bit = (out->data[y * stride + x / 8] >> (7 - x % 8)) & 1;
+			if (bit != ref->index[y * ref->width + x]) {
+				fprintf(stderr, "image %u: pixel %u,%u differs from the reference\n", image, x, y);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, r, sets = 0, nb_errors = 0;
+	GF_Filter *filter;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, images[i].seed, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	filter = host_filter_new(&BMP1BPPRegister, "packed=true");
+	if (!filter) {
+		fprintf(stderr, "cannot create the filter\n");
+		return 1;
+	}
+	for (i = 0; i < NB_IMAGES; i++) {
+		/* the second time, nothing changes on the PID */
+		for (r = 0; r < 2; r++) {
+			u32 before = host_filter_pid_sets(filter, 0);
+			host_output_clear(&out);
+			host_filter_push(filter, bmps[i], bmp_sizes[i]);
+			if (host_filter_run(filter, &out) != GF_OK) {
+				fprintf(stderr, "image %u not decoded\n", i);
+				nb_errors++;
+				continue;
+			}
+			nb_errors += check_image(filter, i, &out);
+			sets = host_filter_pid_sets(filter, 0) - before;
+			if (r && sets) {
+				fprintf(stderr, "image %u sets %u PID properties again\n", i, sets);
+				nb_errors++;
+			}
+			/* the same size with a new palette only sets the palette */
+			if (!r && i == 3 && sets != 1) {
+				fprintf(stderr, "image %u, a palette change, sets %u PID properties\n", i, sets);
+				nb_errors++;
+			}
+		}
+	}
+	host_filter_finalize(filter);
+	host_filter_free(filter);
+
+	host_output_reset(&out);
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u images failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u packed images match the reference\n", NB_IMAGES);
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Palettes with their own kernels (black and white, white and black, two
+ * greys) and palettes that only become one of those once formatted must
+ * expand exactly as the reference decode does, at widths around every
+ * kernel group size, in every pixel format and with every kernel set the
+ * build and CPU have; the others must be refused.
+ * The kernels picked by tuning must be saved as a profile of known sets,
+ * and the benchmark must not run again in the same process.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+/* the two palette entries, as RGB */
+static const u8 palettes[][2][3] = {
+	{ { 0, 0, 0 }, { 255, 255, 255 } },
+	{ { 255, 255, 255 }, { 0, 0, 0 } },
+	{ { 64, 64, 64 }, { 200, 200, 200 } },
+	{ { 17, 17, 17 }, { 17, 17, 17 } },
+	{ { 255, 0, 0 }, { 0, 0, 255 } },
+	/* black and white only as grey or 565 */
+	{ { 0, 0, 0 }, { 255, 255, 254 } },
+};
+#define NB_PALETTES	(sizeof(palettes) / sizeof(palettes[0]))
+
+static const u32 widths[] = { 1, 7, 15, 16, 17, 31, 33, 63, 64, 65, 129, 250, 1031 };
+#define NB_WIDTHS	(sizeof(widths) / sizeof(widths[0]))
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "bgr", GF_PIXEL_BGR }, { "rgba", GF_PIXEL_RGBA }, { "rgbx", GF_PIXEL_RGBX },
+	{ "grey", GF_PIXEL_GREYSCALE }, { "rgb565", GF_PIXEL_RGB_565 }, { "yuv", GF_PIXEL_YUV }, { "nv12", GF_PIXEL_NV12 },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+/* whether each set must exist in this build: 1 yes, 0 no, -1 if it depends on the CPU */
+static const struct
+{
+	const char *name;
+	int expected;
+} kernels[] = {
+	{ "scalar", 1 },
+#if defined(__SSE2__) || defined(_M_X64)
+	{ "sse2", 1 }, { "avx2", -1 },
+#else
+	{ "sse2", 0 }, { "avx2", 0 },
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	{ "neon", 1 },
+#else
+	{ "neon", 0 },
+#endif
+#if defined(__wasm_simd128__)
+	{ "simd128", 1 },
+#else
+	{ "simd128", 0 },
+#endif
+	{ "auto", 1 },
+};
+#define NB_KERNELS	(sizeof(kernels) / sizeof(kernels[0]))
+
+/* the saved profile lists one known kernel set per pixel size */
+static Bool check_profile(void)
+{
+	static const char *sets[] = { "scalar", "sse2", "avx2", "neon", "simd128" };
+	const char *names = gf_opts_get_key("BMP1BPP", "kernels");
+	u32 p, s;
+
+	for (p = 0; names && p < 4; p++) {
+		size_t len = strcspn(names, ",");
+		for (s = 0; s < sizeof(sets) / sizeof(sets[0]); s++)
+			if (strlen(sets[s]) == len && !strncmp(sets[s], names, len)) break;
+		if (s == sizeof(sets) / sizeof(sets[0])) return GF_FALSE;
+		names += len;
+		if (*names == ',') names++;
+	}
+	return names && p == 4 && !*names;
+}
+
+int main(int argc, char **argv)
+{
+	u32 p, w, f, k, lazy, nb_errors = 0, nb_images = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	/* a profile naming a set this build lacks is tuned again */
+	gf_opts_set_key("BMP1BPP", "kernels", "scalar,nosuchset,scalar,scalar");
+
+	for (k = 0; k < NB_KERNELS; k++) {
+		for (lazy = 0; lazy < 2; lazy++) {
+			for (f = 0; f < NB_FORMATS; f++) {
+				char args[64];
+				GF_Filter *filter;
+
+				snprintf(args, sizeof(args), "kernel=%s:pfmt=%s:lazy=%s", kernels[k].name, formats[f].name, lazy ? "true" : "false");
+				filter = host_filter_new(&BMP1BPPRegister, args);
+				/* a set the build or CPU lacks is refused */
+				if ((filter && !kernels[k].expected) || (!filter && kernels[k].expected > 0)) {
+					fprintf(stderr, "%s: filter %s\n", args, filter ? "created with a set this build lacks" : "not created");
+					return 1;
+				}
+				if (!filter) continue;
+				for (p = 0; p < NB_PALETTES; p++) {
+					for (w = 0; w < NB_WIDTHS; w++) {
+						u32 bmp_size, size, c;
+						u8 *bmp = host_make_bmp(widths[w], 5, w % 2, 1000 + w, &bmp_size);
+						u8 *expected;
+						RefImage ref;
+
+						/* palette entries are BGRA from offset 54 */
+						for (c = 0; c < 3; c++) {
+							bmp[54 + 2 - c] = palettes[p][0][c];
+							bmp[58 + 2 - c] = palettes[p][1][c];
+						}
+						ref_load(&ref, bmp, bmp_size);
+						expected = ref_expand(&ref, formats[f].pfmt, &size);
+
+						host_output_clear(&out);
+						host_filter_push(filter, bmp, bmp_size);
+						if (host_filter_run(filter, &out) != GF_OK) {
+							fprintf(stderr, "%s: palette %u, width %u not decoded\n", args, p, widths[w]);
+							nb_errors++;
+						} else if (out.size != size || memcmp(out.data, expected, size)) {
+							fprintf(stderr, "%s: palette %u, width %u differs from the reference\n", args, p, widths[w]);
+							nb_errors++;
+						}
+						free(expected);
+						ref_free(&ref);
+						free(bmp);
+						nb_images++;
+					}
+				}
+				host_filter_finalize(filter);
+				host_filter_free(filter);
+			}
+		}
+	}
+
+	host_output_reset(&out);
+	if (!check_profile()) {
+		fprintf(stderr, "no valid kernel profile saved after tuning: %s\n", gf_opts_get_key("BMP1BPP", "kernels"));
+		nb_errors++;
+	} else {
+		/* later instances use the profile of the process, even when asked to retune */
+		GF_Filter *filter;
+		gf_opts_set_key("BMP1BPP", "kernels", "left,as,it,is");
+		filter = host_filter_new(&BMP1BPPRegister, "kernel=auto:retune=true:threads=1");
+		if (!filter || strcmp(gf_opts_get_key("BMP1BPP", "kernels"), "left,as,it,is")) {
+			fprintf(stderr, "the kernels were benchmarked again in the same process\n");
+			nb_errors++;
+		}
+		if (filter) {
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+		}
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u images failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u images of special palettes match the reference\n", nb_images);
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Images repeating the header of the one before reuse its decode plan:
+ * each must still decode its own pixels with its own palette, as the
+ * reference does, across palette, size and format changes and after a
+ * truncated image.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "rgba", GF_PIXEL_RGBA }, { "grey", GF_PIXEL_GREYSCALE },
+	{ "rgb565", GF_PIXEL_RGB_565 }, { "yuv", GF_PIXEL_YUV }, { "nv12", GF_PIXEL_NV12 },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+/* header and palette bytes of host_make_bmp images */
+#define HEADER_SIZE	62
+
+typedef struct
+{
+	u8 *data;
+	u32 size;
+	/* fed cut short, and must be rejected */
+	Bool truncated;
+} Step;
+
+static Step steps[9];
+static u32 nb_steps;
+
+static void add_step(u8 *data, u32 size, Bool truncated)
+{
+	steps[nb_steps].data = data;
+	steps[nb_steps].size = size;
+	steps[nb_steps].truncated = truncated;
+	nb_steps++;
+}
+
+static u8 *copy(const u8 *data, u32 size)
+{
+	u8 *dup = malloc(size);
+	memcpy(dup, data, size);
+	return dup;
+}
+
+static u32 run(GF_Filter *filter, const char *what, u32 pfmt)
+{
+	u32 k, nb_errors = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (k = 0; k < nb_steps; k++) {
+		GF_Err e;
+
+		host_output_clear(&out);
+		host_filter_push(filter, steps[k].data, steps[k].truncated ? steps[k].size - 10 : steps[k].size);
+		e = host_filter_run(filter, &out);
+		if (steps[k].truncated) {
+			if (e == GF_OK || out.nb_packets) {
+				fprintf(stderr, "%s: truncated image %u not rejected\n", what, k);
+				nb_errors++;
+			}
+		} else if (e != GF_OK) {
+			fprintf(stderr, "%s: image %u not decoded\n", what, k);
+			nb_errors++;
+		} else {
+			RefImage ref;
+			u32 size;
+			u8 *expected;
+
+			ref_load(&ref, steps[k].data, steps[k].size);
+			expected = ref_expand(&ref, pfmt, &size);
+			if (out.size != size || memcmp(out.data, expected, size)) {
+				fprintf(stderr, "%s: image %u differs from the reference\n", what, k);
+				nb_errors++;
+			}
+			free(expected);
+			ref_free(&ref);
+		}
+	}
+	host_output_reset(&out);
+	return nb_errors;
+}
+
+int main(int argc, char **argv)
+{
+	u32 a_size, b_size, c_size, d_size, e_size, k, f, lazy, nb_errors = 0;
+	u8 *a = host_make_bmp(100, 37, GF_FALSE, 1100, &a_size);
+	u8 *b = host_make_bmp(100, 37, GF_FALSE, 1101, &b_size);
+	u8 *c = host_make_bmp(100, 37, GF_FALSE, 1102, &c_size);
+	u8 *d = host_make_bmp(64, 64, GF_TRUE, 1103, &d_size);
+	/* the size of a with another palette, to be fed truncated */
+	u8 *e = host_make_bmp(100, 37, GF_FALSE, 1104, &e_size);
+	u8 *same_header = copy(b, b_size);
+
+	/* the header and palette of a over other pixels */
+	memcpy(same_header, a, HEADER_SIZE);
+	free(b);
+
+	add_step(a, a_size, GF_FALSE);
+	add_step(same_header, b_size, GF_FALSE);
+	/* same size, another palette */
+	add_step(c, c_size, GF_FALSE);
+	add_step(a, a_size, GF_FALSE);
+	add_step(d, d_size, GF_FALSE);
+	add_step(a, a_size, GF_TRUE);
+	add_step(same_header, b_size, GF_FALSE);
+	/* a rejected image must not leave its palette to the plan */
+	add_step(e, e_size, GF_TRUE);
+	add_step(a, a_size, GF_FALSE);
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			char args[64], what[96];
+			GF_Filter *filter;
+			u32 to = formats[(f + 1) % NB_FORMATS].pfmt;
+
+			snprintf(args, sizeof(args), "pfmt=%s:lazy=%s", formats[f].name, lazy ? "true" : "false");
+			filter = host_filter_new(&BMP1BPPRegister, args);
+			if (!filter) {
+				fprintf(stderr, "%s: cannot create the filter\n", args);
+				return 1;
+			}
+			nb_errors += run(filter, args, formats[f].pfmt);
+
+			/* the same images after a format change */
+			snprintf(what, sizeof(what), "%s then %s", args, formats[(f + 1) % NB_FORMATS].name);
+			if (host_filter_reconfigure(filter, to) != GF_OK) {
+				fprintf(stderr, "%s: negotiation refused\n", what);
+				nb_errors++;
+			} else {
+				nb_errors += run(filter, what, to);
+			}
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+		}
+	}
+
+	for (k = 0; k < nb_steps; k++) {
+		u32 j;
+		/* each buffer once */
+		for (j = 0; j < k && steps[j].data != steps[k].data; j++) ;
+		if (j == k) free(steps[k].data);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u checks failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u images repeating headers match the reference\n", nb_steps);
+	return 0;
+}
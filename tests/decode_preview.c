@@ -0,0 +1,119 @@
+/*
+ * Progressive mode: each image must first come as a preview made of one
+ * pixel in N of one row in N, then as the full frame, each tagged with its
+ * quality and with the PID geometry of its own size.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	5
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 7, 3, GF_TRUE }, { 100, 37, GF_FALSE }, { 257, 64, GF_TRUE }, { 2063, 17, GF_FALSE },
+};
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "bgr", GF_PIXEL_BGR }, { "rgba", GF_PIXEL_RGBA }, { "rgbx", GF_PIXEL_RGBX },
+	{ "grey", GF_PIXEL_GREYSCALE }, { "rgb565", GF_PIXEL_RGB_565 },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static const u32 steps[] = { 2, 3, 8, 1000 };
+#define NB_STEPS	(sizeof(steps) / sizeof(steps[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+/* packet k of out against img, with the given quality */
+static Bool check_packet(const HostOutput *out, u32 k, const RefImage *img, u32 pfmt, u32 quality)
+{
+	const HostPacket *pck = &out->packets[k];
+	const GF_PropertyValue *q = host_packet_property_str(pck, "bmp_quality");
+	u32 size;
+	u8 *expected;
+	Bool ok;
+
+	if (!q || q->value.uint != quality || pck->width != img->width || pck->height != img->height) return GF_FALSE;
+	expected = ref_expand(img, pfmt, &size);
+	ok = (pck->size == size && !memcmp(out->data + pck->offset, expected, size));
+	free(expected);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, s, lazy, nb_errors = 0, nb_runs = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 800 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			for (s = 0; s < NB_STEPS; s++) {
+				char args[96];
+				GF_Filter *filter;
+
+				snprintf(args, sizeof(args), "preview=%u:pfmt=%s:lazy=%s:threads=%u:bandpix=64", steps[s], formats[f].name, lazy ? "true" : "false", 1 + (f + s) % 3);
+				filter = host_filter_new(&BMP1BPPRegister, args);
+				if (!filter) {
+					fprintf(stderr, "%s: cannot create the filter\n", args);
+					return 1;
+				}
+				for (i = 0; i < NB_IMAGES; i++) {
+					RefImage sampled;
+
+					host_output_clear(&out);
+					host_filter_push(filter, bmps[i], bmp_sizes[i]);
+					if (host_filter_run(filter, &out) != GF_OK || out.nb_packets != 2) {
+						fprintf(stderr, "%s: image %u not decoded as a preview and a frame\n", args, i);
+						nb_errors++;
+						continue;
+					}
+					ref_sample(&refs[i], steps[s], &sampled);
+					if (!check_packet(&out, 0, &sampled, formats[f].pfmt, 0)) {
+						fprintf(stderr, "%s: image %u, the preview differs from the reference\n", args, i);
+						nb_errors++;
+					}
+					if (!check_packet(&out, 1, &refs[i], formats[f].pfmt, 1)) {
+						fprintf(stderr, "%s: image %u, the full frame differs from the reference\n", args, i);
+						nb_errors++;
+					}
+					ref_free(&sampled);
+				}
+				host_filter_finalize(filter);
+				host_filter_free(filter);
+				nb_runs++;
+			}
+		}
+	}
+
+	host_output_reset(&out);
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u checks failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u preview runs match the reference\n", nb_runs);
+	return 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * Pyramids: each image must come out at full size on the first PID, then
+ * halved level by level on one PID each until both sides fit in the
+ * pyramid size, every reduced pixel the rounded mean of the 2x2 block
+ * (or the 2x1, 1x2 or lone pixel on odd edges) of the level above it.
+ * The level PIDs are all there from the start, the ones an image is too
+ * small for are at end of stream, and nothing is set again on a PID when
+ * the same image comes twice.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	6
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 7, 3, GF_TRUE }, { 100, 37, GF_FALSE }, { 257, 64, GF_TRUE }, { 1031, 17, GF_FALSE }, { 33, 600, GF_TRUE },
+};
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "bgr", GF_PIXEL_BGR }, { "rgba", GF_PIXEL_RGBA }, { "rgbx", GF_PIXEL_RGBX }, { "grey", GF_PIXEL_GREYSCALE },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static const u32 sizes[] = { 1, 5, 64, 100000 };
+#define NB_SIZES	(sizeof(sizes) / sizeof(sizes[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+/* the next level of a w x h frame of p bytes per pixel, rows packed */
+static u8 *halve(const u8 *src, u32 w, u32 h, u32 p)
+{
+	u32 hw = (w + 1) / 2, hh = (h + 1) / 2, x, y, i, j, c;
+	u8 *dst = malloc(hw * hh * p);
+
+	for (y = 0; y < hh; y++) {
+		for (x = 0; x < hw; x++) {
+			for (c = 0; c < p; c++) {
+				u32 sum = 0, n = 0;
+				for (j = 2 * y; j < 2 * y + 2 && j < h; j++)
+					for (i = 2 * x; i < 2 * x + 2 && i < w; i++, n++)
+						sum += src[(j * w + i) * p + c];
+				dst[(y * hw + x) * p + c] = (u8) ((sum + n / 2) / n);
+			}
+		}
+	}
+	return dst;
+}
+
+/* reduced levels of a w x h image */
+static u32 nb_levels(u32 w, u32 h, u32 pyramid)
+{
+	u32 nb = 0;
+	while (w > pyramid || h > pyramid) {
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+		nb++;
+	}
+	return nb;
+}
+
+/* the levels an image used are live, the others at end of stream */
+static u32 check_eos(GF_Filter *filter, const char *what, u32 image, u32 nb)
+{
+	u32 k;
+	for (k = 1; k < host_filter_nb_pids(filter); k++) {
+		if (host_filter_pid_eos(filter, k) != (k > nb)) {
+			fprintf(stderr, "%s: image %u has %u levels, level %u is %sat end of stream\n", what, image, nb, k, (k > nb) ? "not " : "");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static u32 total_sets(GF_Filter *filter)
+{
+	u32 k, sets = 0;
+	for (k = 0; k < host_filter_nb_pids(filter); k++)
+		sets += host_filter_pid_sets(filter, k);
+	return sets;
+}
+
+static u32 check(GF_Filter *filter, const char *what, u32 pyramid, u32 pfmt)
+{
+	u32 i, sets, nb_errors = 0, p = ref_pixel_size(pfmt);
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		u32 w = refs[i].width, h = refs[i].height, size, k;
+		u8 *expected = ref_expand(&refs[i], pfmt, &size);
+
+		host_output_clear(&out);
+		host_filter_push(filter, bmps[i], bmp_sizes[i]);
+		if (host_filter_run(filter, &out) != GF_OK) {
+			fprintf(stderr, "%s: image %u not decoded\n", what, i);
+			nb_errors++;
+			free(expected);
+			continue;
+		}
+
+		for (k = 0; ; k++) {
+			const HostPacket *pck = k < out.nb_packets ? &out.packets[k] : NULL;
+			const GF_PropertyValue *level = host_filter_pid_property_str(filter, k, "bmp_pyramid_level");
+			u8 *next;
+
+			if (!pck || pck->pid != k || pck->width != w || pck->height != h || (k ? !level || level->value.uint != k : level != NULL)) {
+				fprintf(stderr, "%s: image %u, level %u is missing or has the wrong size\n", what, i, k);
+				nb_errors++;
+				break;
+			}
+			if (pck->size != w * h * p || memcmp(out.data + pck->offset, expected, pck->size)) {
+				fprintf(stderr, "%s: image %u, level %u differs from the reference\n", what, i, k);
+				nb_errors++;
+				break;
+			}
+			if (w <= pyramid && h <= pyramid) {
+				if (k + 1 != out.nb_packets) {
+					fprintf(stderr, "%s: image %u has %u levels, %u expected\n", what, i, out.nb_packets, k + 1);
+					nb_errors++;
+				}
+				break;
+			}
+			next = halve(expected, w, h, p);
+			free(expected);
+			expected = next;
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+		}
+		free(expected);
+		nb_errors += check_eos(filter, what, i, nb_levels(refs[i].width, refs[i].height, pyramid));
+	}
+
+	/* the same image again sets nothing */
+	sets = total_sets(filter);
+	host_filter_push(filter, bmps[NB_IMAGES - 1], bmp_sizes[NB_IMAGES - 1]);
+	if (host_filter_run(filter, NULL) != GF_OK || total_sets(filter) != sets) {
+		fprintf(stderr, "%s: the same image again sets %u PID properties\n", what, total_sets(filter) - sets);
+		nb_errors++;
+	}
+	host_output_reset(&out);
+	return nb_errors;
+}
+
+/* the input PID announces its size, so fewer levels are declared and larger images stop at the last of them */
+static u32 check_announced(void)
+{
+	GF_Filter *filter = host_filter_new_input(&BMP1BPPRegister, "pyramid=64:pfmt=grey", 257, 64);
+	u32 nb_errors = 0, order[3] = { 3, 4, 2 }, i;
+	HostOutput out;
+
+	if (!filter) {
+		fprintf(stderr, "announced size: cannot create the filter\n");
+		return 1;
+	}
+	memset(&out, 0, sizeof(out));
+	if (host_filter_nb_pids(filter) != 4) {
+		fprintf(stderr, "announced 257x64: %u PIDs declared, 4 expected\n", host_filter_nb_pids(filter));
+		nb_errors++;
+	}
+	for (i = 0; i < 3; i++) {
+		u32 nb = nb_levels(refs[order[i]].width, refs[order[i]].height, 64);
+		if (nb > 3) nb = 3;
+		host_output_clear(&out);
+		host_filter_push(filter, bmps[order[i]], bmp_sizes[order[i]]);
+		if (host_filter_run(filter, &out) != GF_OK || out.nb_packets != nb + 1) {
+			fprintf(stderr, "announced 257x64: image %u gives %u frames, %u expected\n", order[i], out.nb_packets, nb + 1);
+			nb_errors++;
+		}
+		nb_errors += check_eos(filter, "announced 257x64", order[i], nb);
+	}
+	host_filter_finalize(filter);
+	host_filter_free(filter);
+	host_output_reset(&out);
+	return nb_errors;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, s, nb_errors = 0, nb_runs = 0;
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 700 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (f = 0; f < NB_FORMATS; f++) {
+		for (s = 0; s < NB_SIZES; s++) {
+			char args[96], what[128];
+			GF_Filter *filter;
+			u32 to = formats[(f + 1) % NB_FORMATS].pfmt;
+
+			/* small bands, so that each builds its share of every level */
+			snprintf(args, sizeof(args), "pyramid=%u:pfmt=%s:threads=%u:bandpix=64", sizes[s], formats[f].name, 1 + (f + s) % 3);
+			filter = host_filter_new(&BMP1BPPRegister, args);
+			if (!filter) {
+				fprintf(stderr, "%s: cannot create the filter\n", args);
+				return 1;
+			}
+			/* the input does not give its size, so every level there can be is declared */
+			if (host_filter_nb_pids(filter) != 25) {
+				fprintf(stderr, "%s: %u PIDs declared, 25 expected\n", args, host_filter_nb_pids(filter));
+				nb_errors++;
+			}
+			nb_errors += check(filter, args, sizes[s], formats[f].pfmt);
+
+			/* a new format applies to every level */
+			snprintf(what, sizeof(what), "%s then %s", args, formats[(f + 1) % NB_FORMATS].name);
+			if (host_filter_reconfigure(filter, to) != GF_OK) {
+				fprintf(stderr, "%s: negotiation refused\n", what);
+				nb_errors++;
+			} else {
+				nb_errors += check(filter, what, sizes[s], to);
+			}
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+			nb_runs++;
+		}
+	}
+
+	nb_errors += check_announced();
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u checks failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u pyramid runs match the reference\n", nb_runs);
+	return 0;
+}
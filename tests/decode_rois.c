@@ -0,0 +1,170 @@
+/*
+ * Regions of interest: only the listed rectangles are output, in list
+ * order and clipped to the image, each tagged with its index in the list
+ * and matching the same area of the reference decode. The list can be
+ * changed between images, and a bad list leaves the current one in place.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	3
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 5, 3, GF_FALSE }, { 150, 61, GF_TRUE }, { 1031, 40, GF_FALSE },
+};
+
+static const char *formats[] = { "rgb", "rgba", "grey", "yuv", "nv12" };
+static const u32 pfmts[] = { GF_PIXEL_RGB, GF_PIXEL_RGBA, GF_PIXEL_GREYSCALE, GF_PIXEL_YUV, GF_PIXEL_NV12 };
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+/* region lists, applied in turn to a running filter */
+static const char *lists[] = {
+	"1x1+0+0",
+	"3x2+1+1,1x1+4+2,7x9+3+0",
+	"64x16+7+3,33x33+100+20,9x5+1000+30,2x2+149+60",
+	"17x1+9+0,1x17+0+9,5x5+2000+0,2000x2000+1+1",
+};
+#define NB_LISTS	(sizeof(lists) / sizeof(lists[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+static u32 check_image(GF_Filter *filter, const char *what, u32 image, u32 pfmt, const char *list, const HostOutput *out)
+{
+	const RefImage *ref = &refs[image];
+	const GF_PropertyValue *p;
+	const char *s = list;
+	u32 id = 0, nb = 0;
+
+	p = host_filter_pid_property_str(filter, 0, "bmp_full_width");
+	if (!p || p->value.uint != ref->width) {
+		fprintf(stderr, "%s: image %u has the wrong full width\n", what, image);
+		return 1;
+	}
+	p = host_filter_pid_property_str(filter, 0, "bmp_full_height");
+	if (!p || p->value.uint != ref->height) {
+		fprintf(stderr, "%s: image %u has the wrong full height\n", what, image);
+		return 1;
+	}
+
+	for (; s; id++, s = strchr(s, ','), s = s ? s + 1 : NULL) {
+		u32 x, y, w, h, size;
+		const HostPacket *pck;
+		const GF_PropertyValue *pid, *px, *py;
+		RefImage part;
+		u8 *expected;
+		Bool ok;
+
+		sscanf(s, "%ux%u+%u+%u", &w, &h, &x, &y);
+		if (x >= ref->width || y >= ref->height) continue;
+		if (w > ref->width - x) w = ref->width - x;
+		if (h > ref->height - y) h = ref->height - y;
+
+		if (nb >= out->nb_packets) {
+			fprintf(stderr, "%s: image %u is missing region %u\n", what, image, id);
+			return 1;
+		}
+		pck = &out->packets[nb++];
+		pid = host_packet_property_str(pck, "bmp_roi_id");
+		px = host_packet_property_str(pck, "bmp_roi_x");
+		py = host_packet_property_str(pck, "bmp_roi_y");
+		if (!pid || pid->value.uint != id || !px || px->value.uint != x || !py || py->value.uint != y
+			|| pck->width != w || pck->height != h) {
+			fprintf(stderr, "%s: image %u, region %u has the wrong position or size\n", what, image, id);
+			return 1;
+		}
+
+		if (pck->start != (nb == 1) || pck->end != (nb == out->nb_packets)) {
+			fprintf(stderr, "%s: image %u, region %u has framing %d %d\n", what, image, id, pck->start, pck->end);
+			return 1;
+		}
+
+		ref_crop(ref, x, y, w, h, &part);
+		expected = ref_expand(&part, pfmt, &size);
+		ok = (pck->size == size && !memcmp(out->data + pck->offset, expected, size));
+		free(expected);
+		ref_free(&part);
+		if (!ok) {
+			fprintf(stderr, "%s: image %u, region %u differs from the reference\n", what, image, id);
+			return 1;
+		}
+	}
+	if (nb != out->nb_packets) {
+		fprintf(stderr, "%s: image %u has %u regions, %u expected\n", what, image, out->nb_packets, nb);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, l, lazy, nb_errors = 0, nb_runs = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 500 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			char args[128];
+			GF_Filter *filter;
+
+			snprintf(args, sizeof(args), "roi=%s:pfmt=%s:lazy=%s:threads=%u", lists[0], formats[f], lazy ? "true" : "false", 1 + f % 3);
+			filter = host_filter_new(&BMP1BPPRegister, args);
+			if (!filter) {
+				fprintf(stderr, "%s: cannot create the filter\n", args);
+				return 1;
+			}
+			for (l = 0; l < NB_LISTS; l++) {
+				char what[256];
+
+				/* a bad list is refused and the previous one stays */
+				if (l && (host_filter_update_arg(filter, "roi", "3x3+1") == GF_OK
+					|| host_filter_update_arg(filter, "roi", lists[l]) != GF_OK)) {
+					fprintf(stderr, "%s: region list %u not taken as expected\n", args, l);
+					nb_errors++;
+					continue;
+				}
+				snprintf(what, sizeof(what), "%s, roi=%s", args, lists[l]);
+				for (i = 0; i < NB_IMAGES; i++) {
+					host_output_clear(&out);
+					host_filter_push(filter, bmps[i], bmp_sizes[i]);
+					if (host_filter_run(filter, &out) != GF_OK) {
+						fprintf(stderr, "%s: image %u not decoded\n", what, i);
+						nb_errors++;
+					} else {
+						nb_errors += check_image(filter, what, i, pfmts[f], lists[l], &out);
+					}
+				}
+				nb_runs++;
+			}
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+		}
+	}
+
+	host_output_reset(&out);
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u images failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u region lists match the reference\n", nb_runs);
+	return 0;
+}
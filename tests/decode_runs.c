@@ -0,0 +1,121 @@
+/*
+ * Rows made of long runs of one color, split by a few mixed bytes or
+ * ending anywhere in a word, must expand exactly as the reference decode
+ * does, in every pixel format, whether or not the row takes the uniform
+ * run path.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	6
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 17, 9, GF_FALSE }, { 64, 16, GF_TRUE }, { 513, 24, GF_FALSE }, { 1000, 40, GF_TRUE }, { 4099, 33, GF_FALSE }, { 2048, 8, GF_FALSE },
+};
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "bgr", GF_PIXEL_BGR }, { "rgba", GF_PIXEL_RGBA }, { "rgbx", GF_PIXEL_RGBX },
+	{ "grey", GF_PIXEL_GREYSCALE }, { "rgb565", GF_PIXEL_RGB_565 }, { "yuv", GF_PIXEL_YUV }, { "nv12", GF_PIXEL_NV12 },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+/* replaces the random pixels of a host_make_bmp image by rows of runs */
+static void make_runs(u8 *bmp, u32 w, u32 h)
+{
+	u32 stride = ((w + 31) / 32) * 4, y, b, seed = w;
+
+	for (y = 0; y < h; y++) {
+		u8 *row = bmp + 62 + y * stride;
+		for (b = 0; b < stride; b++) {
+			seed = seed * 1103515245 + 12345;
+			switch (y % 8) {
+			case 0: row[b] = 0x00; break;
+			case 1: row[b] = 0xFF; break;
+			/* blank with one mixed byte moving along the row */
+			case 2: row[b] = (b == (y * 7) % stride) ? 0x81 : 0x00; break;
+			/* 8-byte words alternating between the colors */
+			case 3: row[b] = ((b / 8) % 2) ? 0xFF : 0x00; break;
+			/* a run then noise */
+			case 4: row[b] = (b < stride / 3) ? 0xFF : (u8) (seed >> 16); break;
+			case 5: row[b] = (u8) (seed >> 16); break;
+			/* blank up to the last pixel, which is set */
+			case 6: row[b] = (b == (w - 1) / 8) ? (u8) (0x80 >> ((w - 1) % 8)) : 0x00; break;
+			/* runs of both colors with a stray byte every 29 */
+			default: row[b] = (b % 29 == 28) ? 0x5A : ((b / 24) % 2 ? 0x00 : 0xFF); break;
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, lazy, nb_errors = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 900 + i, &bmp_sizes[i]);
+		make_runs(bmps[i], images[i].w, images[i].h);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			char args[96];
+			GF_Filter *filter;
+
+			snprintf(args, sizeof(args), "pfmt=%s:lazy=%s:threads=%u:bandpix=256", formats[f].name, lazy ? "true" : "false", 1 + f % 3);
+			filter = host_filter_new(&BMP1BPPRegister, args);
+			if (!filter) {
+				fprintf(stderr, "%s: cannot create the filter\n", args);
+				return 1;
+			}
+			for (i = 0; i < NB_IMAGES; i++) {
+				u32 size;
+				u8 *expected = ref_expand(&refs[i], formats[f].pfmt, &size);
+
+				host_output_clear(&out);
+				host_filter_push(filter, bmps[i], bmp_sizes[i]);
+				if (host_filter_run(filter, &out) != GF_OK) {
+					fprintf(stderr, "%s: image %u not decoded\n", args, i);
+					nb_errors++;
+				} else if (out.size != size || memcmp(out.data, expected, size)) {
+					fprintf(stderr, "%s: image %u differs from the reference\n", args, i);
+					nb_errors++;
+				}
+				free(expected);
+			}
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+		}
+	}
+
+	host_output_reset(&out);
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u images failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u formats, eager and lazy, match the reference on rows of runs\n", (u32) NB_FORMATS);
+	return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * Scaled frames: each downscaled pixel must mix the two palette colors by
+ * their share of its block, edge blocks weighted by the pixels they
+ * cover, each upscaled pixel must be a square block of its source pixel,
+ * and each resampled pixel must shade the colors by the share of the
+ * area it covers, as computed pixel by pixel from the reference.
+ * Scaling is refused along with regions, tiles or strips, and only the
+ * output path actually taken limits the pixel formats downstream can ask.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	6
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 7, 3, GF_TRUE }, { 100, 37, GF_FALSE }, { 257, 64, GF_TRUE }, { 2063, 17, GF_FALSE },
+	/* black and white, for plain grey levels */
+	{ 61, 29, GF_FALSE },
+};
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "bgr", GF_PIXEL_BGR }, { "rgba", GF_PIXEL_RGBA }, { "rgbx", GF_PIXEL_RGBX },
+	{ "grey", GF_PIXEL_GREYSCALE }, { "rgb565", GF_PIXEL_RGB_565 },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static const char *scales[] = {
+	"downscale=2", "downscale=4", "downscale=8", "upscale=2", "upscale=3", "upscale=4",
+	"osize=1x1", "osize=640x480", "osize=37x300", "osize=1000x5", "osize=300x2",
+};
+#define NB_SCALES	(sizeof(scales) / sizeof(scales[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+static u32 check(GF_Filter *filter, const char *what, const char *scale, u32 pfmt)
+{
+	u32 i, nb_errors = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		u32 w, h, k, size;
+		u8 *expected;
+		const GF_PropertyValue *stride;
+
+		if (sscanf(scale, "downscale=%u", &k) == 1) {
+			w = (refs[i].width + k - 1) / k;
+			h = (refs[i].height + k - 1) / k;
+			expected = ref_downscale(&refs[i], k, pfmt, &size);
+		} else if (sscanf(scale, "upscale=%u", &k) == 1) {
+			RefImage zoomed;
+			ref_zoom(&refs[i], k, &zoomed);
+			w = zoomed.width;
+			h = zoomed.height;
+			expected = ref_expand(&zoomed, pfmt, &size);
+			ref_free(&zoomed);
+		} else {
+			sscanf(scale, "osize=%ux%u", &w, &h);
+			expected = ref_resample(&refs[i], w, h, pfmt, &size);
+		}
+
+		host_output_clear(&out);
+		host_filter_push(filter, bmps[i], bmp_sizes[i]);
+		if (host_filter_run(filter, &out) != GF_OK || out.nb_packets != 1) {
+			fprintf(stderr, "%s: image %u not decoded as one frame\n", what, i);
+			nb_errors++;
+		} else if (out.packets[0].width != w || out.packets[0].height != h
+			|| !(stride = host_filter_pid_property(filter, 0, GF_PROP_PID_STRIDE)) || stride->value.uint != w * ref_pixel_size(pfmt)) {
+			fprintf(stderr, "%s: image %u is %ux%u, %ux%u expected\n", what, i, out.packets[0].width, out.packets[0].height, w, h);
+			nb_errors++;
+		} else if (out.size != size || memcmp(out.data, expected, size)) {
+			fprintf(stderr, "%s: image %u differs from the reference\n", what, i);
+			nb_errors++;
+		}
+		free(expected);
+	}
+	host_output_reset(&out);
+	return nb_errors;
+}
+
+/* options scaling whole frames cannot go with the ones cutting them */
+static const char *refused[] = {
+	"downscale=2:strip=16", "upscale=2:tile=32x32", "osize=64x64:roi=8x8+0+0", "downscale=4:roi=1x1+0+0,2x2+3+3",
+};
+#define NB_REFUSED	(sizeof(refused) / sizeof(refused[0]))
+
+/* downstream asking for YUV: refused only where frames are scaled or previewed */
+static const struct
+{
+	const char *args;
+	const char *roi;
+	GF_Err e;
+} negotiations[] = {
+	{ "downscale=2", NULL, GF_NOT_SUPPORTED },
+	{ "osize=30x30", NULL, GF_NOT_SUPPORTED },
+	{ "preview=2", NULL, GF_NOT_SUPPORTED },
+	{ "strip=16", NULL, GF_OK },
+	{ "tile=32x32", NULL, GF_OK },
+	/* regions set while running replace the preview */
+	{ "preview=2", "8x8+0+0", GF_OK },
+	/* the pyramid takes precedence, and its levels refuse YUV anyway */
+	{ "pyramid=64:downscale=2:strip=16", NULL, GF_NOT_SUPPORTED },
+};
+#define NB_NEGOTIATIONS	(sizeof(negotiations) / sizeof(negotiations[0]))
+
+static u32 check_options(void)
+{
+	u32 i, sets, nb_errors = 0;
+	GF_Filter *filter;
+
+	for (i = 0; i < NB_REFUSED; i++) {
+		filter = host_filter_new(&BMP1BPPRegister, refused[i]);
+		if (filter) {
+			fprintf(stderr, "%s: accepted\n", refused[i]);
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+			nb_errors++;
+		}
+	}
+
+	for (i = 0; i < NB_NEGOTIATIONS; i++) {
+		GF_Err e;
+		filter = host_filter_new(&BMP1BPPRegister, negotiations[i].args);
+		if (!filter) {
+			fprintf(stderr, "%s: cannot create the filter\n", negotiations[i].args);
+			nb_errors++;
+			continue;
+		}
+		if (negotiations[i].roi && host_filter_update_arg(filter, "roi", negotiations[i].roi) != GF_OK) {
+			fprintf(stderr, "%s: roi %s refused\n", negotiations[i].args, negotiations[i].roi);
+			nb_errors++;
+		}
+		e = host_filter_reconfigure(filter, GF_PIXEL_YUV);
+		if (e != negotiations[i].e) {
+			fprintf(stderr, "%s: yuv asked for, %s\n", negotiations[i].args, e ? "refused" : "accepted");
+			nb_errors++;
+		}
+		host_filter_finalize(filter);
+		host_filter_free(filter);
+	}
+
+	/* no regions while running either, and the same image twice sets nothing again */
+	filter = host_filter_new(&BMP1BPPRegister, "downscale=2");
+	if (!filter) {
+		fprintf(stderr, "downscale=2: cannot create the filter\n");
+		return nb_errors + 1;
+	}
+	if (host_filter_update_arg(filter, "roi", "8x8+0+0") == GF_OK) {
+		fprintf(stderr, "downscale=2: roi accepted while running\n");
+		nb_errors++;
+	}
+	for (i = 0; i < 2; i++) {
+		sets = host_filter_pid_sets(filter, 0);
+		host_filter_push(filter, bmps[2], bmp_sizes[2]);
+		if (host_filter_run(filter, NULL) != GF_OK) {
+			fprintf(stderr, "downscale=2: image not decoded\n");
+			nb_errors++;
+		} else if (i && host_filter_pid_sets(filter, 0) != sets) {
+			fprintf(stderr, "downscale=2: the same image again sets %u PID properties\n", host_filter_pid_sets(filter, 0) - sets);
+			nb_errors++;
+		}
+	}
+	host_filter_finalize(filter);
+	host_filter_free(filter);
+	return nb_errors;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, s, lazy, nb_errors = 0, nb_runs = 0;
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 600 + i, &bmp_sizes[i]);
+		if (i == NB_IMAGES - 1) {
+			/* palette entries are BGRA from offset 54 */
+			memset(bmps[i] + 54, 0, 3);
+			memset(bmps[i] + 58, 255, 3);
+		}
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			for (s = 0; s < NB_SCALES; s++) {
+				char args[96];
+				GF_Filter *filter;
+
+				/* small bands, so that they start at any output row */
+				snprintf(args, sizeof(args), "%s:pfmt=%s:lazy=%s:threads=%u:bandpix=64", scales[s], formats[f].name, lazy ? "true" : "false", 1 + (f + s) % 3);
+				filter = host_filter_new(&BMP1BPPRegister, args);
+				if (!filter) {
+					fprintf(stderr, "%s: cannot create the filter\n", args);
+					return 1;
+				}
+				nb_errors += check(filter, args, scales[s], formats[f].pfmt);
+				host_filter_finalize(filter);
+				host_filter_free(filter);
+				nb_runs++;
+			}
+		}
+	}
+
+	nb_errors += check_options();
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u checks failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u scaled runs match the reference\n", nb_runs);
+	return 0;
+}
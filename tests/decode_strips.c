@@ -0,0 +1,166 @@
+/*
+ * Strip mode: every image must come as strips of the requested height,
+ * top first, the last one giving its own height, each flagged and positioned
+ * in the full image, and each matching the same rows of the reference
+ * decode. The PID keeps the strip height, and is not set again by an image
+ * of the same size.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	4
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 9, 10, GF_TRUE }, { 75, 33, GF_FALSE }, { 256, 64, GF_TRUE },
+};
+
+static const char *formats[] = { "rgb", "rgba", "grey", "yuv", "nv12" };
+static const u32 pfmts[] = { GF_PIXEL_RGB, GF_PIXEL_RGBA, GF_PIXEL_GREYSCALE, GF_PIXEL_YUV, GF_PIXEL_NV12 };
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static const u32 strips[] = { 1, 2, 5, 16, 1000 };
+#define NB_STRIPS	(sizeof(strips) / sizeof(strips[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+static u32 check_image(GF_Filter *filter, const char *what, u32 image, u32 pfmt, u32 strip, const HostOutput *out)
+{
+	const RefImage *ref = &refs[image];
+	const GF_PropertyValue *p;
+	u32 rows, y = 0, k;
+
+	/* strips cover whole chroma rows */
+	rows = (pfmt == GF_PIXEL_YUV || pfmt == GF_PIXEL_NV12) ? (strip + 1) & ~1 : strip;
+
+	p = host_filter_pid_property_str(filter, 0, "bmp_full_width");
+	if (!p || p->value.uint != ref->width) {
+		fprintf(stderr, "%s: image %u has the wrong full width\n", what, image);
+		return 1;
+	}
+	p = host_filter_pid_property_str(filter, 0, "bmp_full_height");
+	if (!p || p->value.uint != ref->height) {
+		fprintf(stderr, "%s: image %u has the wrong full height\n", what, image);
+		return 1;
+	}
+
+	for (k = 0; k < out->nb_packets; k++) {
+		const HostPacket *pck = &out->packets[k];
+		u32 h = ref->height - y < rows ? ref->height - y : rows, size;
+		RefImage part;
+		u8 *expected;
+		Bool ok;
+
+		if (y == ref->height) {
+			fprintf(stderr, "%s: image %u has too many strips\n", what, image);
+			return 1;
+		}
+		if (pck->height != rows || pck->start != (y == 0) || pck->end != (y + h == ref->height)) {
+			fprintf(stderr, "%s: image %u, strip %u has PID height %u and framing %d %d\n", what, image, k, pck->height, pck->start, pck->end);
+			return 1;
+		}
+		p = host_packet_property_str(pck, "bmp_strip_height");
+		if ((y + h == ref->height) ? (!p || p->value.uint != h) : (p != NULL)) {
+			fprintf(stderr, "%s: image %u, strip %u has the wrong strip height\n", what, image, k);
+			return 1;
+		}
+		p = host_packet_property_str(pck, "bmp_strip_y");
+		if (!p || p->value.uint != y) {
+			fprintf(stderr, "%s: image %u, strip %u has the wrong position\n", what, image, k);
+			return 1;
+		}
+		p = host_packet_property_str(pck, "bmp_strip_offset");
+		if (!p || p->value.longuint != (u64) y * ref->width * ref_pixel_size(pfmt)) {
+			fprintf(stderr, "%s: image %u, strip %u has the wrong byte offset\n", what, image, k);
+			return 1;
+		}
+
+		ref_crop(ref, 0, y, ref->width, h, &part);
+		expected = ref_expand(&part, pfmt, &size);
+		ok = (pck->size == size && !memcmp(out->data + pck->offset, expected, size));
+		free(expected);
+		ref_free(&part);
+		if (!ok) {
+			fprintf(stderr, "%s: image %u, strip %u differs from the reference\n", what, image, k);
+			return 1;
+		}
+		y += h;
+	}
+	if (y != ref->height) {
+		fprintf(stderr, "%s: image %u stops after %u rows\n", what, image, y);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, s, lazy, nb_errors = 0, nb_runs = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 300 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			for (s = 0; s < NB_STRIPS; s++) {
+				char args[64];
+				GF_Filter *filter;
+
+				snprintf(args, sizeof(args), "strip=%u:pfmt=%s:lazy=%s", strips[s], formats[f], lazy ? "true" : "false");
+				filter = host_filter_new(&BMP1BPPRegister, args);
+				if (!filter) {
+					fprintf(stderr, "%s: cannot create the filter\n", args);
+					return 1;
+				}
+				for (i = 0; i < NB_IMAGES; i++) {
+					u32 sets = 0, r;
+					/* the second time, nothing changes on the PID */
+					for (r = 0; r < 2; r++) {
+						host_output_clear(&out);
+						host_filter_push(filter, bmps[i], bmp_sizes[i]);
+						if (host_filter_run(filter, &out) != GF_OK) {
+							fprintf(stderr, "%s: image %u not decoded\n", args, i);
+							nb_errors++;
+						} else {
+							nb_errors += check_image(filter, args, i, pfmts[f], strips[s], &out);
+						}
+						if (r && host_filter_pid_sets(filter, 0) != sets) {
+							fprintf(stderr, "%s: image %u sets %u PID properties again\n", args, i, host_filter_pid_sets(filter, 0) - sets);
+							nb_errors++;
+						}
+						sets = host_filter_pid_sets(filter, 0);
+					}
+				}
+				host_filter_finalize(filter);
+				host_filter_free(filter);
+				nb_runs++;
+			}
+		}
+	}
+
+	host_output_reset(&out);
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u images failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u strip runs match the reference\n", nb_runs);
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Tile mode: every image must come as its grid of tiles, row by row and
+ * left to right, the edge tiles smaller, each tagged with its position and
+ * matching the same area of the reference decode, whatever the alignment
+ * of its left edge in the source bits.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	4
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 23, 9, GF_TRUE }, { 130, 41, GF_FALSE }, { 3000, 12, GF_TRUE },
+};
+
+static const char *formats[] = { "rgb", "rgb565", "grey", "yuv", "nv12" };
+static const u32 pfmts[] = { GF_PIXEL_RGB, GF_PIXEL_RGB_565, GF_PIXEL_GREYSCALE, GF_PIXEL_YUV, GF_PIXEL_NV12 };
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static const char *tiles[] = { "1x1", "3x5", "8x8", "13x4", "64x16", "4096x4096" };
+#define NB_TILES	(sizeof(tiles) / sizeof(tiles[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+
+static u32 check_image(GF_Filter *filter, const char *what, u32 image, u32 pfmt, u32 tw, u32 th, const HostOutput *out)
+{
+	const RefImage *ref = &refs[image];
+	u32 cols = (ref->width + tw - 1) / tw, rows = (ref->height + th - 1) / th, k;
+	const GF_PropertyValue *p;
+
+	p = host_filter_pid_property_str(filter, 0, "bmp_tile_cols");
+	if (!p || p->value.uint != cols) {
+		fprintf(stderr, "%s: image %u has the wrong number of tile columns\n", what, image);
+		return 1;
+	}
+	p = host_filter_pid_property_str(filter, 0, "bmp_tile_rows");
+	if (!p || p->value.uint != rows) {
+		fprintf(stderr, "%s: image %u has the wrong number of tile rows\n", what, image);
+		return 1;
+	}
+	if (out->nb_packets != cols * rows) {
+		fprintf(stderr, "%s: image %u has %u tiles, %u expected\n", what, image, out->nb_packets, cols * rows);
+		return 1;
+	}
+
+	for (k = 0; k < out->nb_packets; k++) {
+		const HostPacket *pck = &out->packets[k];
+		u32 x = (k % cols) * tw, y = (k / cols) * th, size;
+		u32 w = ref->width - x < tw ? ref->width - x : tw;
+		u32 h = ref->height - y < th ? ref->height - y : th;
+		const GF_PropertyValue *id = host_packet_property_str(pck, "bmp_tile_id");
+		const GF_PropertyValue *px = host_packet_property_str(pck, "bmp_tile_x");
+		const GF_PropertyValue *py = host_packet_property_str(pck, "bmp_tile_y");
+		RefImage part;
+		u8 *expected;
+		Bool ok;
+
+		if (!id || id->value.uint != k || !px || px->value.uint != x || !py || py->value.uint != y) {
+			fprintf(stderr, "%s: image %u, tile %u has the wrong position\n", what, image, k);
+			return 1;
+		}
+		if (pck->width != w || pck->height != h || pck->start != (k == 0) || pck->end != (k + 1 == out->nb_packets)) {
+			fprintf(stderr, "%s: image %u, tile %u is %ux%u with framing %d %d\n", what, image, k, pck->width, pck->height, pck->start, pck->end);
+			return 1;
+		}
+
+		ref_crop(ref, x, y, w, h, &part);
+		expected = ref_expand(&part, pfmt, &size);
+		ok = (pck->size == size && !memcmp(out->data + pck->offset, expected, size));
+		free(expected);
+		ref_free(&part);
+		if (!ok) {
+			fprintf(stderr, "%s: image %u, tile %u differs from the reference\n", what, image, k);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, t, lazy, nb_errors = 0, nb_runs = 0;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 400 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		for (f = 0; f < NB_FORMATS; f++) {
+			for (t = 0; t < NB_TILES; t++) {
+				char args[64];
+				GF_Filter *filter;
+				u32 tw, th;
+
+				sscanf(tiles[t], "%ux%u", &tw, &th);
+				snprintf(args, sizeof(args), "tile=%s:pfmt=%s:lazy=%s:threads=%u", tiles[t], formats[f], lazy ? "true" : "false", 1 + t % 3);
+				filter = host_filter_new(&BMP1BPPRegister, args);
+				if (!filter) {
+					fprintf(stderr, "%s: cannot create the filter\n", args);
+					return 1;
+				}
+				for (i = 0; i < NB_IMAGES; i++) {
+					host_output_clear(&out);
+					host_filter_push(filter, bmps[i], bmp_sizes[i]);
+					if (host_filter_run(filter, &out) != GF_OK) {
+						fprintf(stderr, "%s: image %u not decoded\n", args, i);
+						nb_errors++;
+					} else {
+						nb_errors += check_image(filter, args, i, pfmts[f], tw, th, &out);
+					}
+				}
+				host_filter_finalize(filter);
+				host_filter_free(filter);
+				nb_runs++;
+			}
+		}
+	}
+
+	host_output_reset(&out);
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u images failed\n", nb_errors);
+		return 1;
+	}
+	printf("%u tile runs match the reference\n", nb_runs);
+	return 0;
+}
@@ -0,0 +1,859 @@
+/*
+ * The GPAC calls made by the BMP1BPP filter, implemented on top of libc and
+ * pthreads. Only what the filter uses is provided, with no more behavior
+ * than the tests need.
+ */
+#include "gpac_host.h"
+#include <gpac/thread.h>
+#include <gpac/config_file.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define HOST_MAX_PROPS	64
+#define HOST_MAX_PIDS	32
+
+struct __gf_filter_pid
+{
+	GF_Filter *filter;
+	u32 index;
+	HostProp props[HOST_MAX_PROPS];
+	u32 nb_props;
+	/* property sets, changed or not: each one reconfigures the PID in a session */
+	u32 nb_sets;
+	/* set at end of stream, cleared by the next packet */
+	Bool eos;
+};
+
+struct __gf_filter_pck
+{
+	GF_FilterPid *pid;
+	u8 *data;
+	u32 size;
+	Bool own;
+	gf_fsess_packet_destructor destruct;
+	GF_FilterFrameInterface *ifce;
+	HostProp props[HOST_MAX_PROPS];
+	u32 nb_props;
+	/* input packets live until dropped and unreferenced */
+	u32 refs;
+	Bool start, end;
+	GF_FilterPacket *reference;
+};
+
+struct __gf_filter
+{
+	void *udta;
+	const GF_FilterRegister *reg;
+	GF_FilterPid in;
+	GF_FilterPid *out[HOST_MAX_PIDS];
+	u32 nb_out;
+	GF_FilterPacket **in_q;
+	u32 in_n, in_pos, in_alloc;
+	HostOutput *capture;
+	GF_FilterPacket *held[HOST_HOLD];
+	u32 nb_held;
+	/* packets sent while keeping, neither read nor released */
+	Bool keep;
+	GF_FilterPacket **kept;
+	u32 nb_kept, alloc_kept;
+	/* answer to the pixel format caps query, when set */
+	GF_PropertyValue caps_pfmt;
+};
+
+
+/* properties */
+
+static void store_prop(HostProp *prop, const GF_PropertyValue *val)
+{
+	prop->val = *val;
+	if (val->type == GF_PROP_DATA && val->value.data.ptr && val->value.data.size <= sizeof(prop->data))
+		memcpy(prop->data, val->value.data.ptr, val->value.data.size);
+}
+
+static void set_prop(HostProp *props, u32 *nb, u32 key, const GF_PropertyValue *val)
+{
+	u32 i;
+	for (i = 0; i < *nb; i++) {
+		if (props[i].key != key) continue;
+		if (val) store_prop(&props[i], val);
+		else props[i] = props[--(*nb)];
+		return;
+	}
+	if (!val || *nb == HOST_MAX_PROPS) return;
+	props[*nb].key = key;
+	store_prop(&props[*nb], val);
+	(*nb)++;
+}
+
+static const GF_PropertyValue *get_prop(const HostProp *props, u32 nb, u32 key)
+{
+	u32 i;
+	for (i = 0; i < nb; i++) {
+		if (props[i].key != key) continue;
+		/* props are copied around whole, the data goes with them */
+		if (props[i].val.type == GF_PROP_DATA && props[i].val.value.data.size <= sizeof(props[i].data))
+			((HostProp *) &props[i])->val.value.data.ptr = (u8 *) props[i].data;
+		return &props[i].val;
+	}
+	return NULL;
+}
+
+static u32 prop_str_key(const char *name)
+{
+	u32 h = 5381;
+	while (*name) h = h * 33 + (u8) *name++;
+	return h ? h : 1;
+}
+
+GF_Err gf_filter_pid_set_property(GF_FilterPid *pid, u32 prop_4cc, const GF_PropertyValue *value)
+{
+	set_prop(pid->props, &pid->nb_props, prop_4cc, value);
+	pid->nb_sets++;
+	return GF_OK;
+}
+GF_Err gf_filter_pid_set_property_str(GF_FilterPid *pid, const char *name, const GF_PropertyValue *value)
+{
+	return gf_filter_pid_set_property(pid, prop_str_key(name), value);
+}
+const GF_PropertyValue *gf_filter_pid_get_property(GF_FilterPid *pid, u32 prop_4cc)
+{
+	return get_prop(pid->props, pid->nb_props, prop_4cc);
+}
+const GF_PropertyValue *gf_filter_pid_get_property_str(GF_FilterPid *pid, const char *prop_name)
+{
+	return gf_filter_pid_get_property(pid, prop_str_key(prop_name));
+}
+GF_Err gf_filter_pck_set_property(GF_FilterPacket *pck, u32 prop_4cc, const GF_PropertyValue *value)
+{
+	set_prop(pck->props, &pck->nb_props, prop_4cc, value);
+	return GF_OK;
+}
+GF_Err gf_filter_pck_set_property_str(GF_FilterPacket *pck, const char *name, const GF_PropertyValue *value)
+{
+	return gf_filter_pck_set_property(pck, prop_str_key(name), value);
+}
+const GF_PropertyValue *gf_filter_pck_get_property(GF_FilterPacket *pck, u32 prop_4cc)
+{
+	return get_prop(pck->props, pck->nb_props, prop_4cc);
+}
+GF_Err gf_filter_pid_copy_properties(GF_FilterPid *dst, GF_FilterPid *src) { return GF_OK; }
+GF_Err gf_filter_pck_merge_properties(GF_FilterPacket *src, GF_FilterPacket *dst) { return GF_OK; }
+const GF_PropertyValue *gf_filter_pid_caps_query(GF_FilterPid *pid, u32 prop_4cc)
+{
+	if (prop_4cc != GF_PROP_PID_PIXFMT || !pid->filter->caps_pfmt.type) return NULL;
+	return &pid->filter->caps_pfmt;
+}
+const char *gf_pixel_fmt_name(GF_PixelFormat pfmt) { return "pfmt"; }
+
+
+/* filter and PIDs */
+
+void *gf_filter_get_udta(GF_Filter *filter) { return filter->udta; }
+void gf_filter_set_name(GF_Filter *filter, const char *name) { }
+void gf_filter_post_process_task(GF_Filter *filter) { }
+void gf_filter_ask_rt_reschedule(GF_Filter *filter, u32 us_until_next) { }
+
+GF_FilterPid *gf_filter_pid_new(GF_Filter *filter)
+{
+	GF_FilterPid *pid;
+	if (filter->nb_out == HOST_MAX_PIDS) return NULL;
+	pid = calloc(1, sizeof(GF_FilterPid));
+	pid->filter = filter;
+	pid->index = filter->nb_out;
+	filter->out[filter->nb_out++] = pid;
+	return pid;
+}
+void gf_filter_pid_remove(GF_FilterPid *pid) { }
+void gf_filter_pid_set_udta(GF_FilterPid *pid, void *udta) { }
+void gf_filter_pid_set_eos(GF_FilterPid *pid) { pid->eos = GF_TRUE; }
+Bool gf_filter_pid_check_caps(GF_FilterPid *pid) { return GF_TRUE; }
+GF_Err gf_filter_pid_set_framing_mode(GF_FilterPid *pid, Bool requires_full_blocks) { return GF_OK; }
+
+GF_FilterPacket *gf_filter_pid_get_packet(GF_FilterPid *pid)
+{
+	GF_Filter *filter = pid->filter;
+	return (filter->in_pos < filter->in_n) ? filter->in_q[filter->in_pos] : NULL;
+}
+void gf_filter_pck_unref(GF_FilterPacket *pck)
+{
+	if (--pck->refs) return;
+	free(pck->data);
+	free(pck);
+}
+GF_Err gf_filter_pck_ref(GF_FilterPacket **pck)
+{
+	(*pck)->refs++;
+	return GF_OK;
+}
+void gf_filter_pid_drop_packet(GF_FilterPid *pid)
+{
+	GF_Filter *filter = pid->filter;
+	if (filter->in_pos == filter->in_n) return;
+	gf_filter_pck_unref(filter->in_q[filter->in_pos++]);
+}
+Bool gf_filter_pid_is_eos(GF_FilterPid *pid)
+{
+	return pid->filter->in_pos == pid->filter->in_n;
+}
+
+
+/* packets */
+
+static GF_FilterPacket *new_packet(GF_FilterPid *pid, u32 size)
+{
+	GF_FilterPacket *pck = calloc(1, sizeof(GF_FilterPacket));
+	pck->pid = pid;
+	pck->size = size;
+	return pck;
+}
+
+GF_FilterPacket *gf_filter_pck_new_alloc(GF_FilterPid *pid, u32 data_size, u8 **data)
+{
+	GF_FilterPacket *pck = new_packet(pid, data_size);
+	pck->data = malloc(data_size ? data_size : 1);
+	pck->own = GF_TRUE;
+	if (data) *data = pck->data;
+	return pck;
+}
+GF_FilterPacket *gf_filter_pck_new_alloc_destructor(GF_FilterPid *pid, u32 data_size, u8 **data, gf_fsess_packet_destructor destruct)
+{
+	GF_FilterPacket *pck = gf_filter_pck_new_alloc(pid, data_size, data);
+	pck->destruct = destruct;
+	return pck;
+}
+GF_FilterPacket *gf_filter_pck_new_shared(GF_FilterPid *pid, const u8 *data, u32 data_size, gf_fsess_packet_destructor destruct)
+{
+	GF_FilterPacket *pck = new_packet(pid, data_size);
+	pck->data = (u8 *) data;
+	pck->destruct = destruct;
+	return pck;
+}
+GF_FilterPacket *gf_filter_pck_new_ref(GF_FilterPid *pid, u32 data_offset, u32 data_size, GF_FilterPacket *reference)
+{
+	GF_FilterPacket *pck = new_packet(pid, data_size ? data_size : reference->size - data_offset);
+	pck->data = reference->data + data_offset;
+	pck->reference = reference;
+	reference->refs++;
+	return pck;
+}
+GF_FilterPacket *gf_filter_pck_new_frame_interface(GF_FilterPid *pid, GF_FilterFrameInterface *frame_ifce, gf_fsess_packet_destructor destruct)
+{
+	GF_FilterPacket *pck = new_packet(pid, 0);
+	pck->ifce = frame_ifce;
+	pck->destruct = destruct;
+	return pck;
+}
+GF_FilterFrameInterface *gf_filter_pck_get_frame_interface(GF_FilterPacket *pck) { return pck->ifce; }
+const u8 *gf_filter_pck_get_data(GF_FilterPacket *pck, u32 *size)
+{
+	*size = pck->size;
+	return pck->data;
+}
+GF_Err gf_filter_pck_set_framing(GF_FilterPacket *pck, Bool is_start, Bool is_end)
+{
+	pck->start = is_start;
+	pck->end = is_end;
+	return GF_OK;
+}
+GF_Err gf_filter_pck_get_framing(GF_FilterPacket *pck, Bool *is_start, Bool *is_end)
+{
+	if (is_start) *is_start = pck->start;
+	if (is_end) *is_end = pck->end;
+	return GF_OK;
+}
+GF_Err gf_filter_pck_set_cts(GF_FilterPacket *pck, u64 cts) { return GF_OK; }
+u64 gf_filter_pck_get_cts(GF_FilterPacket *pck) { return 0; }
+GF_Err gf_filter_pck_set_sap(GF_FilterPacket *pck, GF_FilterSAPType sap_type) { return GF_OK; }
+
+void gf_filter_pck_discard(GF_FilterPacket *pck)
+{
+	if (pck->destruct) pck->destruct(pck->pid->filter, pck->pid, pck);
+	if (pck->own) free(pck->data);
+	if (pck->reference) gf_filter_pck_unref(pck->reference);
+	free(pck);
+}
+
+static void output_append(HostOutput *out, const u8 *data, u32 size)
+{
+	if (out->size + size > out->alloc) {
+		out->alloc = 2 * (out->size + size);
+		out->data = realloc(out->data, out->alloc);
+	}
+	memcpy(out->data + out->size, data, size);
+	out->size += size;
+}
+
+GF_Err gf_filter_pck_send(GF_FilterPacket *pck)
+{
+	GF_Filter *filter = pck->pid->filter;
+
+	pck->pid->eos = GF_FALSE;
+	if (filter->keep) {
+		if (filter->nb_kept == filter->alloc_kept) {
+			filter->alloc_kept = filter->alloc_kept ? 2 * filter->alloc_kept : 16;
+			filter->kept = realloc(filter->kept, filter->alloc_kept * sizeof(GF_FilterPacket *));
+		}
+		filter->kept[filter->nb_kept++] = pck;
+		return GF_OK;
+	}
+
+	if (filter->capture) {
+		HostOutput *out = filter->capture;
+		HostPacket *rec;
+		const GF_PropertyValue *w = gf_filter_pid_get_property(pck->pid, GF_PROP_PID_WIDTH);
+		const GF_PropertyValue *h = gf_filter_pid_get_property(pck->pid, GF_PROP_PID_HEIGHT);
+
+		if (out->nb_packets == out->alloc_packets) {
+			out->alloc_packets = out->alloc_packets ? 2 * out->alloc_packets : 16;
+			out->packets = realloc(out->packets, out->alloc_packets * sizeof(HostPacket));
+		}
+		rec = &out->packets[out->nb_packets++];
+		memset(rec, 0, sizeof(HostPacket));
+		rec->offset = out->size;
+		rec->pid = pck->pid->index;
+		rec->width = w ? w->value.uint : 0;
+		rec->height = h ? h->value.uint : 0;
+		rec->start = pck->start;
+		rec->end = pck->end;
+		if (pck->nb_props) {
+			rec->props = malloc(pck->nb_props * sizeof(HostProp));
+			memcpy(rec->props, pck->props, pck->nb_props * sizeof(HostProp));
+			rec->nb_props = pck->nb_props;
+		}
+
+		if (pck->ifce) {
+			/* the planes of YUV and NV12 frames after the first have half the rows,
+			   and a shorter last strip gives its own height */
+			const GF_PropertyValue *sh = gf_filter_pck_get_property(pck, prop_str_key("bmp_strip_height"));
+			u32 stride, i, height = sh ? sh->value.uint : rec->height;
+			const u8 *plane;
+			for (i = 0; i < 3; i++) {
+				if (pck->ifce->get_plane(pck->ifce, i, &plane, &stride) != GF_OK) break;
+				output_append(out, plane, stride * (i ? (height + 1) / 2 : height));
+			}
+		} else {
+			output_append(out, pck->data, pck->size);
+		}
+		rec->size = out->size - rec->offset;
+	}
+
+	if (filter->nb_held == HOST_HOLD) {
+		gf_filter_pck_discard(filter->held[0]);
+		memmove(filter->held, filter->held + 1, (HOST_HOLD - 1) * sizeof(GF_FilterPacket *));
+		filter->nb_held--;
+	}
+	filter->held[filter->nb_held++] = pck;
+	return GF_OK;
+}
+
+
+/* threads */
+
+struct __tag_thread
+{
+	pthread_t th;
+	gf_thread_run run;
+	void *par;
+	Bool running;
+};
+struct __tag_mutex
+{
+	pthread_mutex_t mx;
+};
+struct __tag_semaphore
+{
+	sem_t sem;
+};
+
+static void *thread_main(void *par)
+{
+	GF_Thread *th = par;
+	th->run(th->par);
+	return NULL;
+}
+GF_Thread *gf_th_new(const char *name) { return calloc(1, sizeof(GF_Thread)); }
+GF_Err gf_th_run(GF_Thread *th, gf_thread_run run, void *par)
+{
+	th->run = run;
+	th->par = par;
+	if (pthread_create(&th->th, NULL, thread_main, th)) return GF_IO_ERR;
+	th->running = GF_TRUE;
+	return GF_OK;
+}
+void gf_th_stop(GF_Thread *th)
+{
+	if (th->running) pthread_join(th->th, NULL);
+	th->running = GF_FALSE;
+}
+void gf_th_del(GF_Thread *th)
+{
+	gf_th_stop(th);
+	free(th);
+}
+u32 gf_th_id(void) { return (u32) (size_t) pthread_self(); }
+
+GF_Mutex *gf_mx_new(const char *name)
+{
+	GF_Mutex *mx = calloc(1, sizeof(GF_Mutex));
+	pthread_mutex_init(&mx->mx, NULL);
+	return mx;
+}
+void gf_mx_del(GF_Mutex *mx)
+{
+	if (!mx) return;
+	pthread_mutex_destroy(&mx->mx);
+	free(mx);
+}
+u32 gf_mx_p(GF_Mutex *mx)
+{
+	pthread_mutex_lock(&mx->mx);
+	return 1;
+}
+void gf_mx_v(GF_Mutex *mx) { pthread_mutex_unlock(&mx->mx); }
+Bool gf_mx_try_lock(GF_Mutex *mx) { return pthread_mutex_trylock(&mx->mx) ? GF_FALSE : GF_TRUE; }
+
+GF_Semaphore *gf_sema_new(u32 max_count, u32 init_count)
+{
+	GF_Semaphore *sm = calloc(1, sizeof(GF_Semaphore));
+	sem_init(&sm->sem, 0, init_count);
+	return sm;
+}
+void gf_sema_del(GF_Semaphore *sm)
+{
+	if (!sm) return;
+	sem_destroy(&sm->sem);
+	free(sm);
+}
+Bool gf_sema_notify(GF_Semaphore *sm, u32 nb_rel)
+{
+	while (nb_rel--) sem_post(&sm->sem);
+	return GF_TRUE;
+}
+Bool gf_sema_wait(GF_Semaphore *sm)
+{
+	sem_wait(&sm->sem);
+	return GF_TRUE;
+}
+
+
+/* system */
+
+u32 gf_sys_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u32) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+u64 gf_sys_clock_high_res(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+void gf_sleep(u32 ms) { usleep(ms * 1000); }
+u32 gf_sys_get_cpu_count(void) { return (u32) sysconf(_SC_NPROCESSORS_ONLN); }
+Bool gf_sys_get_rti(u32 refresh_time_ms, GF_SystemRTInfo *rti, u32 flags)
+{
+	rti->nb_cores = gf_sys_get_cpu_count();
+	return GF_TRUE;
+}
+u32 gf_sys_get_rti_os(u32 refresh_time_ms, GF_SystemRTInfo *rti, u32 flags) { return 0; }
+
+void *gf_malloc(size_t size) { return malloc(size); }
+void *gf_realloc(void *ptr, size_t size) { return realloc(ptr, size); }
+void gf_free(void *ptr) { free(ptr); }
+char *gf_strdup(const char *str) { return strdup(str); }
+
+void gf_log_lt(GF_LOG_Level ll, GF_LOG_Tool lt) { }
+Bool gf_log_tool_level_on(GF_LOG_Tool log_tool, GF_LOG_Level log_level) { return getenv("BMP1BPP_TEST_LOG") != NULL; }
+void gf_log(const char *fmt, ...)
+{
+	va_list vl;
+	va_start(vl, fmt);
+	vfprintf(stderr, fmt, vl);
+	va_end(vl);
+}
+
+/* in-memory config, shared by all instances as the GPAC config is; a value is
+   never rewritten once set, since another instance may still be reading it */
+#define HOST_MAX_OPTS	256
+static struct
+{
+	char sec[64], key[64], val[256];
+} host_opts[HOST_MAX_OPTS];
+static u32 host_nb_opts;
+static pthread_mutex_t host_opts_mx = PTHREAD_MUTEX_INITIALIZER;
+
+const char *gf_opts_get_key(const char *secName, const char *keyName)
+{
+	const char *val = NULL;
+	u32 i;
+	pthread_mutex_lock(&host_opts_mx);
+	for (i = host_nb_opts; i--; ) {
+		if (!strcmp(host_opts[i].sec, secName) && !strcmp(host_opts[i].key, keyName)) {
+			val = host_opts[i].val;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&host_opts_mx);
+	return val;
+}
+GF_Err gf_opts_set_key(const char *secName, const char *keyName, const char *keyValue)
+{
+	u32 i;
+	pthread_mutex_lock(&host_opts_mx);
+	if (host_nb_opts == HOST_MAX_OPTS) {
+		pthread_mutex_unlock(&host_opts_mx);
+		return GF_OUT_OF_MEM;
+	}
+	i = host_nb_opts;
+	snprintf(host_opts[i].sec, sizeof(host_opts[i].sec), "%s", secName);
+	snprintf(host_opts[i].key, sizeof(host_opts[i].key), "%s", keyName);
+	snprintf(host_opts[i].val, sizeof(host_opts[i].val), "%s", keyValue ? keyValue : "");
+	host_nb_opts++;
+	pthread_mutex_unlock(&host_opts_mx);
+	return GF_OK;
+}
+
+
+/* host side */
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} host_pfmts[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "bgr", GF_PIXEL_BGR }, { "rgba", GF_PIXEL_RGBA }, { "rgbx", GF_PIXEL_RGBX },
+	{ "grey", GF_PIXEL_GREYSCALE }, { "rgb565", GF_PIXEL_RGB_565 }, { "yuv", GF_PIXEL_YUV }, { "nv12", GF_PIXEL_NV12 },
+};
+
+/* comma separated items, as given on a gpac command line */
+static void parse_list(GF_PropStringList *list, const char *val)
+{
+	const char *start = val;
+	list->vals = NULL;
+	list->nb_items = 0;
+	while (val && *val) {
+		const char *end = strchr(start, ',');
+		size_t len = end ? (size_t) (end - start) : strlen(start);
+		list->vals = realloc(list->vals, (list->nb_items + 1) * sizeof(char *));
+		list->vals[list->nb_items] = strndup(start, len);
+		list->nb_items++;
+		if (!end) break;
+		start = end + 1;
+	}
+}
+
+static void free_list(GF_PropStringList *list)
+{
+	u32 i;
+	for (i = 0; i < list->nb_items; i++) free(list->vals[i]);
+	free(list->vals);
+	list->vals = NULL;
+	list->nb_items = 0;
+}
+
+static void set_arg(void *udta, const GF_FilterArgs *arg, const char *val)
+{
+	u8 *ptr = (u8 *) udta + arg->offset_in_private;
+	u32 i;
+
+	if (arg->offset_in_private < 0) return;
+	switch (arg->arg_type) {
+	case GF_PROP_BOOL:
+		*(Bool *) ptr = (val && (!strcmp(val, "true") || !strcmp(val, "yes") || !strcmp(val, "1")));
+		break;
+	case GF_PROP_UINT:
+		if (val && arg->min_max_enum && strchr(arg->min_max_enum, '|')) {
+			const char *e = arg->min_max_enum;
+			size_t len = strlen(val);
+			u32 idx = 0;
+			while (e && (strncmp(e, val, len) || (e[len] != '|' && e[len]))) {
+				e = strchr(e, '|');
+				if (e) e++;
+				idx++;
+			}
+			*(u32 *) ptr = idx;
+		} else {
+			*(u32 *) ptr = val ? (u32) strtoul(val, NULL, 0) : 0;
+		}
+		break;
+	case GF_PROP_PIXFMT:
+		*(u32 *) ptr = 0;
+		for (i = 0; val && i < sizeof(host_pfmts) / sizeof(host_pfmts[0]); i++)
+			if (!strcmp(val, host_pfmts[i].name)) *(u32 *) ptr = host_pfmts[i].pfmt;
+		break;
+	case GF_PROP_VEC2I:
+	{
+		GF_PropVec2i *v = (GF_PropVec2i *) ptr;
+		v->x = v->y = 0;
+		if (val) sscanf(val, "%dx%d", &v->x, &v->y);
+	}
+		break;
+	case GF_PROP_STRING_LIST:
+		free_list((GF_PropStringList *) ptr);
+		parse_list((GF_PropStringList *) ptr, val);
+		break;
+	default:
+		/* strings are left empty */
+		break;
+	}
+}
+
+static void free_args(GF_Filter *filter)
+{
+	u32 i;
+	for (i = 0; filter->reg->args[i].arg_name; i++) {
+		const GF_FilterArgs *arg = &filter->reg->args[i];
+		if (arg->arg_type == GF_PROP_STRING_LIST && arg->offset_in_private >= 0)
+			free_list((GF_PropStringList *) ((u8 *) filter->udta + arg->offset_in_private));
+	}
+}
+
+GF_Filter *host_filter_new(const GF_FilterRegister *reg, const char *args)
+{
+	return host_filter_new_input(reg, args, 0, 0);
+}
+
+GF_Filter *host_filter_new_input(const GF_FilterRegister *reg, const char *args, u32 width, u32 height)
+{
+	GF_Filter *filter = calloc(1, sizeof(GF_Filter));
+	u32 i;
+
+	filter->reg = reg;
+	filter->udta = calloc(1, reg->private_size);
+	filter->in.filter = filter;
+	if (width && height) {
+		gf_filter_pid_set_property(&filter->in, GF_PROP_PID_WIDTH, &PROP_UINT(width));
+		gf_filter_pid_set_property(&filter->in, GF_PROP_PID_HEIGHT, &PROP_UINT(height));
+	}
+	for (i = 0; reg->args[i].arg_name; i++)
+		set_arg(filter->udta, &reg->args[i], reg->args[i].arg_default_val);
+
+	if (args) {
+		char *dup = strdup(args), *tok, *save = NULL;
+		for (tok = strtok_r(dup, ":", &save); tok; tok = strtok_r(NULL, ":", &save)) {
+			char *eq = strchr(tok, '=');
+			if (!eq) continue;
+			*eq = 0;
+			for (i = 0; reg->args[i].arg_name; i++)
+				if (!strcmp(reg->args[i].arg_name, tok)) set_arg(filter->udta, &reg->args[i], eq + 1);
+		}
+		free(dup);
+	}
+
+	if ((reg->initialize && reg->initialize(filter) != GF_OK) || reg->configure_pid(filter, &filter->in, GF_FALSE) != GF_OK) {
+		host_filter_finalize(filter);
+		host_filter_free(filter);
+		return NULL;
+	}
+	return filter;
+}
+
+void *host_filter_udta(GF_Filter *filter) { return filter->udta; }
+
+GF_Err host_filter_update_arg(GF_Filter *filter, const char *name, const char *val)
+{
+	GF_PropertyValue prop;
+	GF_Err e = GF_NOT_FOUND;
+	u32 i;
+
+	for (i = 0; filter->reg->args[i].arg_name; i++) {
+		const GF_FilterArgs *arg = &filter->reg->args[i];
+		if (strcmp(arg->arg_name, name) || !(arg->flags & GF_FS_ARG_UPDATE)) continue;
+		if (arg->arg_type != GF_PROP_STRING_LIST) return GF_NOT_SUPPORTED;
+
+		/* as in a session, the option keeps the new value once the filter accepts it */
+		memset(&prop, 0, sizeof(prop));
+		prop.type = GF_PROP_STRING_LIST;
+		parse_list(&prop.value.string_list, val);
+		e = filter->reg->update_arg ? filter->reg->update_arg(filter, name, &prop) : GF_OK;
+		free_list(&prop.value.string_list);
+		if (!e) set_arg(filter->udta, arg, val);
+		return e;
+	}
+	return e;
+}
+
+const GF_PropertyValue *host_filter_pid_property(GF_Filter *filter, u32 pid_index, u32 prop_4cc)
+{
+	if (pid_index >= filter->nb_out) return NULL;
+	return gf_filter_pid_get_property(filter->out[pid_index], prop_4cc);
+}
+
+const GF_PropertyValue *host_filter_pid_property_str(GF_Filter *filter, u32 pid_index, const char *name)
+{
+	return host_filter_pid_property(filter, pid_index, prop_str_key(name));
+}
+
+u32 host_filter_pid_sets(GF_Filter *filter, u32 pid_index)
+{
+	return pid_index < filter->nb_out ? filter->out[pid_index]->nb_sets : 0;
+}
+
+u32 host_filter_nb_pids(GF_Filter *filter) { return filter->nb_out; }
+
+Bool host_filter_pid_eos(GF_Filter *filter, u32 pid_index)
+{
+	return pid_index < filter->nb_out ? filter->out[pid_index]->eos : GF_FALSE;
+}
+
+GF_Err host_filter_reconfigure(GF_Filter *filter, u32 pfmt)
+{
+	GF_Err e;
+	if (!filter->nb_out || !filter->reg->reconfigure_output) return GF_NOT_SUPPORTED;
+	filter->caps_pfmt.type = GF_PROP_PIXFMT;
+	filter->caps_pfmt.value.uint = pfmt;
+	e = filter->reg->reconfigure_output(filter, filter->out[0]);
+	filter->caps_pfmt.type = 0;
+	return e;
+}
+
+void host_filter_push(GF_Filter *filter, const u8 *data, u32 size)
+{
+	host_filter_push_block(filter, data, size, GF_TRUE, GF_TRUE);
+}
+
+void host_filter_push_block(GF_Filter *filter, const u8 *data, u32 size, Bool start, Bool end)
+{
+	GF_FilterPacket *pck = new_packet(&filter->in, size);
+	pck->refs = 1;
+	pck->start = start;
+	pck->end = end;
+	pck->data = malloc(size ? size : 1);
+	memcpy(pck->data, data, size);
+	if (filter->in_n == filter->in_alloc && filter->in_pos) {
+		/* consumed packets are compacted away first */
+		memmove(filter->in_q, filter->in_q + filter->in_pos, (filter->in_n - filter->in_pos) * sizeof(GF_FilterPacket *));
+		filter->in_n -= filter->in_pos;
+		filter->in_pos = 0;
+	}
+	if (filter->in_n == filter->in_alloc) {
+		filter->in_alloc = filter->in_alloc ? 2 * filter->in_alloc : 16;
+		filter->in_q = realloc(filter->in_q, filter->in_alloc * sizeof(GF_FilterPacket *));
+	}
+	filter->in_q[filter->in_n++] = pck;
+}
+
+GF_Err host_filter_run(GF_Filter *filter, HostOutput *out)
+{
+	GF_Err first = GF_OK;
+
+	filter->capture = out;
+	while (filter->in_pos < filter->in_n) {
+		u32 pos = filter->in_pos;
+		GF_Err e = filter->reg->process(filter);
+		if (e != GF_OK && e != GF_EOS) {
+			if (first == GF_OK) first = e;
+			/* a session would not retry a packet the filter failed on */
+			if (filter->in_pos == pos) gf_filter_pid_drop_packet(&filter->in);
+		}
+	}
+	filter->capture = NULL;
+	return first;
+}
+
+void host_filter_keep_packets(GF_Filter *filter, Bool keep) { filter->keep = keep; }
+
+GF_FilterPacket **host_filter_kept_packets(GF_Filter *filter, u32 *nb)
+{
+	*nb = filter->nb_kept;
+	return filter->kept;
+}
+
+void host_filter_release_kept(GF_Filter *filter)
+{
+	while (filter->nb_kept)
+		gf_filter_pck_discard(filter->kept[--filter->nb_kept]);
+}
+
+void host_filter_finalize(GF_Filter *filter)
+{
+	host_filter_release_kept(filter);
+	while (filter->nb_held)
+		gf_filter_pck_discard(filter->held[--filter->nb_held]);
+	while (filter->in_pos < filter->in_n)
+		gf_filter_pid_drop_packet(&filter->in);
+	if (filter->reg->finalize) filter->reg->finalize(filter);
+}
+
+void host_filter_free(GF_Filter *filter)
+{
+	u32 i;
+	for (i = 0; i < filter->nb_out; i++) free(filter->out[i]);
+	free(filter->in_q);
+	free(filter->kept);
+	free_args(filter);
+	free(filter->udta);
+	free(filter);
+}
+
+void host_output_clear(HostOutput *out)
+{
+	u32 i;
+	for (i = 0; i < out->nb_packets; i++) free(out->packets[i].props);
+	out->nb_packets = 0;
+	out->size = 0;
+}
+
+void host_output_reset(HostOutput *out)
+{
+	host_output_clear(out);
+	free(out->packets);
+	free(out->data);
+	memset(out, 0, sizeof(HostOutput));
+}
+
+const GF_PropertyValue *host_packet_property(const HostPacket *pck, u32 prop_4cc)
+{
+	return get_prop(pck->props, pck->nb_props, prop_4cc);
+}
+
+const GF_PropertyValue *host_packet_property_str(const HostPacket *pck, const char *name)
+{
+	return get_prop(pck->props, pck->nb_props, prop_str_key(name));
+}
+
+static void put_le(u8 *p, u32 v, u32 n)
+{
+	while (n--) {
+		*p++ = (u8) v;
+		v >>= 8;
+	}
+}
+
+u8 *host_make_bmp(u32 w, u32 h, Bool top_down, u32 seed, u32 *size)
+{
+	u32 stride = ((w + 31) / 32) * 4;
+	u32 offset = 14 + 40 + 8;
+	u32 i;
+	u8 *bmp;
+
+	*size = offset + stride * h;
+	bmp = calloc(1, *size);
+	bmp[0] = 'B';
+	bmp[1] = 'M';
+	put_le(bmp + 2, *size, 4);
+	put_le(bmp + 10, offset, 4);
+	put_le(bmp + 14, 40, 4);
+	put_le(bmp + 18, w, 4);
+	put_le(bmp + 22, top_down ? (u32) -(s32) h : h, 4);
+	put_le(bmp + 26, 1, 2);
+	put_le(bmp + 28, 1, 2);
+	put_le(bmp + 34, stride * h, 4);
+	put_le(bmp + 46, 2, 4);
+
+	/* palette then pixels, padding bits included */
+	for (i = 54; i < *size; i++) {
+		seed = seed * 1103515245 + 12345;
+		bmp[i] = (u8) (seed >> 16);
+	}
+	bmp[57] = bmp[61] = 0;
+	return bmp;
+}
@@ -0,0 +1,91 @@
+/*
+ * Minimal host for running the BMP1BPP filter outside of a GPAC session.
+ *
+ * Each GF_Filter made here owns its input queue and its output, so several
+ * instances can run at once from different threads. Output packets are
+ * copied into a HostOutput when sent and held for a few more sends before
+ * being released, as a downstream filter would.
+ */
+#ifndef BMP1BPP_GPAC_HOST_H
+#define BMP1BPP_GPAC_HOST_H
+
+#include <gpac/filters.h>
+
+/* output packets kept alive by the host before their release */
+#define HOST_HOLD	2
+
+typedef struct
+{
+	u32 key;
+	GF_PropertyValue val;
+	/* copy of a small data property, as a session keeps its own */
+	u8 data[64];
+} HostProp;
+
+/* one packet sent by the filter */
+typedef struct
+{
+	/* its bytes in HostOutput.data, all planes of a frame interface */
+	u32 offset, size;
+	/* output PID, in creation order */
+	u32 pid;
+	/* PID size when it was sent */
+	u32 width, height;
+	Bool start, end;
+	HostProp *props;
+	u32 nb_props;
+} HostPacket;
+
+typedef struct
+{
+	u8 *data;
+	u32 size;
+	u32 alloc;
+	HostPacket *packets;
+	u32 nb_packets;
+	u32 alloc_packets;
+} HostOutput;
+
+/* new initialized instance, args given as "name=value:name=value", NULL on failure */
+GF_Filter *host_filter_new(const GF_FilterRegister *reg, const char *args);
+/* same, the input PID announcing a width x height size as a demuxer would */
+GF_Filter *host_filter_new_input(const GF_FilterRegister *reg, const char *args, u32 width, u32 height);
+void *host_filter_udta(GF_Filter *filter);
+/* change an updatable option while running, as gpac does; only string lists are handled */
+GF_Err host_filter_update_arg(GF_Filter *filter, const char *name, const char *val);
+/* property of the output PID created pid_index-th */
+const GF_PropertyValue *host_filter_pid_property(GF_Filter *filter, u32 pid_index, u32 prop_4cc);
+const GF_PropertyValue *host_filter_pid_property_str(GF_Filter *filter, u32 pid_index, const char *name);
+/* property sets made so far on the output PID created pid_index-th, whether they changed the value or not */
+u32 host_filter_pid_sets(GF_Filter *filter, u32 pid_index);
+/* output PIDs created so far */
+u32 host_filter_nb_pids(GF_Filter *filter);
+/* whether the output PID created pid_index-th is at end of stream, no packet sent since */
+Bool host_filter_pid_eos(GF_Filter *filter, u32 pid_index);
+/* downstream asks for pfmt on the first output PID, as a format negotiation would */
+GF_Err host_filter_reconfigure(GF_Filter *filter, u32 pfmt);
+/* queue one framed input packet, the data is copied */
+void host_filter_push(GF_Filter *filter, const u8 *data, u32 size);
+/* queue one block of unframed input, with the framing flags of its packet */
+void host_filter_push_block(GF_Filter *filter, const u8 *data, u32 size, Bool start, Bool end);
+/* process all queued packets, appending what is sent to out (may be NULL); returns the first error */
+GF_Err host_filter_run(GF_Filter *filter, HostOutput *out);
+/* while keep is set, sent packets are neither read nor released, so that the
+   test can read their frames itself; they are released at finalize at the latest */
+void host_filter_keep_packets(GF_Filter *filter, Bool keep);
+GF_FilterPacket **host_filter_kept_packets(GF_Filter *filter, u32 *nb);
+void host_filter_release_kept(GF_Filter *filter);
+/* release held packets and finalize; the private data stays readable until host_filter_free */
+void host_filter_finalize(GF_Filter *filter);
+void host_filter_free(GF_Filter *filter);
+
+/* empties out, keeping its buffers */
+void host_output_clear(HostOutput *out);
+void host_output_reset(HostOutput *out);
+const GF_PropertyValue *host_packet_property(const HostPacket *pck, u32 prop_4cc);
+const GF_PropertyValue *host_packet_property_str(const HostPacket *pck, const char *name);
+
+/* 1bpp BMP of w x h with random pixels and palette from seed, freed with free() */
+u8 *host_make_bmp(u32 w, u32 h, Bool top_down, u32 seed, u32 *size);
+
+#endif
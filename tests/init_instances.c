@@ -0,0 +1,106 @@
+/*
+ * Instances initialised from several threads at once, as the first ones of
+ * the process, must all find the kernel sets filled and the kernels tuned
+ * once, and decode like the reference.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_INSTANCES	16
+
+/* a vector kernel set every build for the target has */
+#if defined(__SSE2__) || defined(_M_X64)
+#define VECTOR_SET	"sse2"
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VECTOR_SET	"neon"
+#elif defined(__wasm_simd128__)
+#define VECTOR_SET	"simd128"
+#else
+#define VECTOR_SET	"scalar"
+#endif
+
+static const char *options[] = {
+	"pfmt=rgb:kernel=" VECTOR_SET,
+	"pfmt=grey:kernel=scalar",
+	"pfmt=rgba:kernel=" VECTOR_SET ":lazy=true",
+	"pfmt=rgb565:kernel=" VECTOR_SET,
+	"pfmt=rgb:kernel=auto:threads=2",
+};
+#define NB_OPTIONS	(sizeof(options) / sizeof(options[0]))
+
+static const u32 pfmts[NB_OPTIONS] = { GF_PIXEL_RGB, GF_PIXEL_GREYSCALE, GF_PIXEL_RGBA, GF_PIXEL_RGB_565, GF_PIXEL_RGB };
+
+static u8 *bmp;
+static u32 bmp_size;
+static RefImage ref;
+static pthread_barrier_t start;
+
+typedef struct
+{
+	u32 index;
+	Bool ok;
+} Instance;
+
+static void *run_instance(void *par)
+{
+	Instance *inst = par;
+	u32 opt = inst->index % NB_OPTIONS, size;
+	u8 *expected = ref_expand(&ref, pfmts[opt], &size);
+	GF_Filter *filter;
+	HostOutput out;
+
+	memset(&out, 0, sizeof(out));
+	pthread_barrier_wait(&start);
+	filter = host_filter_new(&BMP1BPPRegister, options[opt]);
+	if (filter) {
+		host_filter_push(filter, bmp, bmp_size);
+		inst->ok = host_filter_run(filter, &out) == GF_OK && out.size == size && !memcmp(out.data, expected, size);
+		host_filter_finalize(filter);
+		host_filter_free(filter);
+	}
+	if (!inst->ok)
+		fprintf(stderr, "instance %u (%s) does not match the reference\n", inst->index, options[opt]);
+	host_output_reset(&out);
+	free(expected);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[NB_INSTANCES];
+	Instance instances[NB_INSTANCES];
+	u32 i, nb_errors = 0;
+
+	bmp = host_make_bmp(203, 41, GF_FALSE, 7, &bmp_size);
+	ref_load(&ref, bmp, bmp_size);
+	pthread_barrier_init(&start, NULL, NB_INSTANCES);
+
+	for (i = 0; i < NB_INSTANCES; i++) {
+		instances[i].index = i;
+		instances[i].ok = GF_FALSE;
+		if (pthread_create(&threads[i], NULL, run_instance, &instances[i])) {
+			fprintf(stderr, "cannot start instance %u\n", i);
+			return 1;
+		}
+	}
+	for (i = 0; i < NB_INSTANCES; i++) {
+		pthread_join(threads[i], NULL);
+		if (!instances[i].ok) nb_errors++;
+	}
+
+	pthread_barrier_destroy(&start);
+	ref_free(&ref);
+	free(bmp);
+	if (nb_errors) {
+		fprintf(stderr, "%u of %u instances initialised at once failed\n", nb_errors, NB_INSTANCES);
+		return 1;
+	}
+	printf("%u instances initialised at once match the reference\n", NB_INSTANCES);
+	return 0;
+}
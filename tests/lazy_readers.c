@@ -0,0 +1,161 @@
+/*
+ * Lazy frames read by several consumer threads at once, each frame by more
+ * than one of them, must all match the reference decode, whether frames
+ * share their expansion tables or not.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	4
+#define NB_FRAMES	12
+#define NB_READERS	6
+#define NB_ROUNDS	20
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 333, 97, GF_TRUE }, { 1024, 768, GF_FALSE }, { 64, 2000, GF_TRUE },
+};
+
+/* runs of the same image share their tables, the others do not */
+static const u32 sequence[NB_FRAMES] = { 2, 2, 2, 0, 1, 1, 3, 2, 3, 3, 0, 2 };
+
+static const struct
+{
+	const char *name;
+	u32 pfmt;
+} formats[] = {
+	{ "rgb", GF_PIXEL_RGB }, { "rgba", GF_PIXEL_RGBA }, { "grey", GF_PIXEL_GREYSCALE },
+	{ "rgb565", GF_PIXEL_RGB_565 }, { "yuv", GF_PIXEL_YUV }, { "nv12", GF_PIXEL_NV12 },
+};
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+static u8 *expected[NB_IMAGES];
+static u32 expected_sizes[NB_IMAGES];
+
+static GF_FilterPacket **frames;
+static pthread_barrier_t start;
+
+typedef struct
+{
+	u32 index;
+	u32 nb_errors;
+} Reader;
+
+/* reads all planes of frame f into one buffer, as the host does for sent packets */
+static Bool read_frame(u32 f, u8 *buf, u32 *size)
+{
+	GF_FilterFrameInterface *ifce = gf_filter_pck_get_frame_interface(frames[f]);
+	u32 h = refs[sequence[f]].height, stride, i;
+	const u8 *plane;
+
+	*size = 0;
+	if (!ifce) return GF_FALSE;
+	for (i = 0; i < 3; i++) {
+		u32 len;
+		if (ifce->get_plane(ifce, i, &plane, &stride) != GF_OK) break;
+		len = stride * (i ? (h + 1) / 2 : h);
+		memcpy(buf + *size, plane, len);
+		*size += len;
+	}
+	return *size ? GF_TRUE : GF_FALSE;
+}
+
+static void *run_reader(void *par)
+{
+	Reader *r = par;
+	u8 *buf = malloc(expected_sizes[2] > expected_sizes[3] ? expected_sizes[2] : expected_sizes[3]);
+	u32 i, size;
+
+	pthread_barrier_wait(&start);
+	for (i = 0; i < NB_FRAMES; i++) {
+		/* readers start on different frames, so that each frame is first read from several threads */
+		u32 f = (i + (r->index / 2) * 5) % NB_FRAMES;
+		u32 image = sequence[f];
+		if (!read_frame(f, buf, &size) || size != expected_sizes[image] || memcmp(buf, expected[image], size))
+			r->nb_errors++;
+	}
+	free(buf);
+	return NULL;
+}
+
+static u32 check(u32 fmt, u32 round)
+{
+	pthread_t threads[NB_READERS];
+	Reader readers[NB_READERS];
+	GF_Filter *filter;
+	char args[64];
+	u32 i, nb, nb_errors = 0;
+
+	snprintf(args, sizeof(args), "pfmt=%s:lazy=true:threads=2:bandpix=4096", formats[fmt].name);
+	filter = host_filter_new(&BMP1BPPRegister, args);
+	if (!filter) {
+		fprintf(stderr, "%s: cannot create the filter\n", args);
+		return 1;
+	}
+	host_filter_keep_packets(filter, GF_TRUE);
+	for (i = 0; i < NB_FRAMES; i++)
+		host_filter_push(filter, bmps[sequence[i]], bmp_sizes[sequence[i]]);
+	frames = NULL;
+	if (host_filter_run(filter, NULL) != GF_OK || !(frames = host_filter_kept_packets(filter, &nb)) || nb != NB_FRAMES) {
+		fprintf(stderr, "%s: %u frames sent, %u expected\n", args, frames ? nb : 0, NB_FRAMES);
+		nb_errors++;
+	} else {
+		for (i = 0; i < NB_READERS; i++) {
+			readers[i].index = i;
+			readers[i].nb_errors = 0;
+			pthread_create(&threads[i], NULL, run_reader, &readers[i]);
+		}
+		for (i = 0; i < NB_READERS; i++) {
+			pthread_join(threads[i], NULL);
+			if (readers[i].nb_errors && !nb_errors)
+				fprintf(stderr, "%s: round %u, reader %u saw %u frames differ from the reference\n", args, round, i, readers[i].nb_errors);
+			nb_errors += readers[i].nb_errors;
+		}
+	}
+	host_filter_finalize(filter);
+	host_filter_free(filter);
+	return nb_errors;
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, r, nb_errors = 0;
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 300 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+	pthread_barrier_init(&start, NULL, NB_READERS);
+
+	for (f = 0; f < NB_FORMATS; f++) {
+		for (i = 0; i < NB_IMAGES; i++)
+			expected[i] = ref_expand(&refs[i], formats[f].pfmt, &expected_sizes[i]);
+		for (r = 0; r < NB_ROUNDS; r++)
+			nb_errors += check(f, r);
+		for (i = 0; i < NB_IMAGES; i++) free(expected[i]);
+	}
+
+	pthread_barrier_destroy(&start);
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u frame reads differ from the reference\n", nb_errors);
+		return 1;
+	}
+	printf("%u readers x %u lazy frames match the reference in every format\n", NB_READERS, NB_FRAMES);
+	return 0;
+}
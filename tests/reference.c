@@ -0,0 +1,240 @@
+#include "reference.h"
+#include <gpac/constants.h>
+#include <stdlib.h>
+#include <string.h>
+
+static u32 get_le(const u8 *p, u32 n)
+{
+	u32 v = 0;
+	while (n--) v = (v << 8) | p[n];
+	return v;
+}
+
+Bool ref_load(RefImage *img, const u8 *bmp, u32 size)
+{
+	u32 offset, header, stride, x, y, c;
+	s32 height;
+
+	memset(img, 0, sizeof(RefImage));
+	if (size < 54 || bmp[0] != 'B' || bmp[1] != 'M' || get_le(bmp + 28, 2) != 1) return GF_FALSE;
+	offset = get_le(bmp + 10, 4);
+	header = get_le(bmp + 14, 4);
+	img->width = get_le(bmp + 18, 4);
+	height = (s32) get_le(bmp + 22, 4);
+	img->height = height < 0 ? (u32) -height : (u32) height;
+	stride = ((img->width + 31) / 32) * 4;
+	if (offset + stride * img->height > size) return GF_FALSE;
+
+	/* palette entries are stored as B, G, R, reserved */
+	for (c = 0; c < 2; c++) {
+		const u8 *entry = bmp + 14 + header + 4 * c;
+		img->color[c][0] = entry[2];
+		img->color[c][1] = entry[1];
+		img->color[c][2] = entry[0];
+	}
+
+	img->index = malloc(img->width * img->height + 1);
+	for (y = 0; y < img->height; y++) {
+		/* bottom-up files store the last row first */
+		const u8 *row = bmp + offset + stride * (height < 0 ? y : img->height - 1 - y);
+		for (x = 0; x < img->width; x++)
+			img->index[y * img->width + x] = (row[x / 8] >> (7 - x % 8)) & 1;
+	}
+	return GF_TRUE;
+}
+
+void ref_crop(const RefImage *img, u32 x, u32 y, u32 w, u32 h, RefImage *out)
+{
+	u32 j;
+	*out = *img;
+	out->width = w;
+	out->height = h;
+	out->index = malloc(w * h + 1);
+	for (j = 0; j < h; j++)
+		memcpy(out->index + j * w, img->index + (y + j) * img->width + x, w);
+}
+
+void ref_zoom(const RefImage *img, u32 zoom, RefImage *out)
+{
+	u32 x, y;
+	*out = *img;
+	out->width = img->width * zoom;
+	out->height = img->height * zoom;
+	out->index = malloc(out->width * out->height + 1);
+	for (y = 0; y < out->height; y++)
+		for (x = 0; x < out->width; x++)
+			out->index[y * out->width + x] = img->index[(y / zoom) * img->width + x / zoom];
+}
+
+void ref_sample(const RefImage *img, u32 step, RefImage *out)
+{
+	u32 x, y;
+	*out = *img;
+	out->width = (img->width + step - 1) / step;
+	out->height = (img->height + step - 1) / step;
+	out->index = malloc(out->width * out->height + 1);
+	for (y = 0; y < out->height; y++)
+		for (x = 0; x < out->width; x++)
+			out->index[y * out->width + x] = img->index[y * step * img->width + x * step];
+}
+
+void ref_free(RefImage *img)
+{
+	free(img->index);
+	memset(img, 0, sizeof(RefImage));
+}
+
+u32 ref_pixel_size(u32 pfmt)
+{
+	switch (pfmt) {
+	case GF_PIXEL_GREYSCALE:
+	case GF_PIXEL_YUV:
+	case GF_PIXEL_NV12: return 1;
+	case GF_PIXEL_RGB_565: return 2;
+	case GF_PIXEL_RGBA:
+	case GF_PIXEL_RGBX: return 4;
+	default: return 3;
+	}
+}
+
+void ref_format_color(u32 pfmt, const u8 rgb[3], u8 *out)
+{
+	u32 v;
+	switch (pfmt) {
+	case GF_PIXEL_YUV:
+	case GF_PIXEL_NV12:
+		out[0] = (u8) (((66 * rgb[0] + 129 * rgb[1] + 25 * rgb[2] + 128) >> 8) + 16);
+		break;
+	case GF_PIXEL_GREYSCALE:
+		out[0] = (u8) ((77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8);
+		break;
+	case GF_PIXEL_RGB_565:
+		v = ((u32) (rgb[0] >> 3) << 11) | ((u32) (rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+		out[0] = (u8) v;
+		out[1] = (u8) (v >> 8);
+		break;
+	case GF_PIXEL_BGR:
+		out[0] = rgb[2];
+		out[1] = rgb[1];
+		out[2] = rgb[0];
+		break;
+	case GF_PIXEL_RGBA:
+	case GF_PIXEL_RGBX:
+		out[0] = rgb[0];
+		out[1] = rgb[1];
+		out[2] = rgb[2];
+		out[3] = 255;
+		break;
+	default:
+		out[0] = rgb[0];
+		out[1] = rgb[1];
+		out[2] = rgb[2];
+		break;
+	}
+}
+
+/* BT.601 video range U (c = 0) or V (c = 1) of a color, scaled by 256 and offset to stay positive */
+static s32 chroma(u32 c, const u8 rgb[3])
+{
+	if (!c) return -38 * rgb[0] - 74 * rgb[1] + 112 * rgb[2] + 32896;
+	return 112 * rgb[0] - 94 * rgb[1] - 18 * rgb[2] + 32896;
+}
+
+u8 *ref_expand(const RefImage *img, u32 pfmt, u32 *size)
+{
+	u32 p = ref_pixel_size(pfmt), i, c, x, y;
+	u32 cw = (img->width + 1) / 2, ch = (img->height + 1) / 2;
+	u8 *frame, *planes;
+
+	*size = img->width * img->height * p;
+	if (pfmt == GF_PIXEL_YUV || pfmt == GF_PIXEL_NV12) *size += 2 * cw * ch;
+	frame = malloc(*size + 1);
+	for (i = 0; i < img->width * img->height; i++)
+		ref_format_color(pfmt, img->color[img->index[i]], frame + i * p);
+	if (pfmt != GF_PIXEL_YUV && pfmt != GF_PIXEL_NV12) return frame;
+
+	/* 4:2:0 chroma: each sample averages the 2x2 pixels it covers, fewer on odd edges */
+	planes = frame + img->width * img->height;
+	for (c = 0; c < 2; c++) {
+		for (y = 0; y < ch; y++) {
+			for (x = 0; x < cw; x++) {
+				s32 sum = 0, k = 0, dx, dy;
+				for (dy = 0; dy < 2; dy++) {
+					for (dx = 0; dx < 2; dx++) {
+						u32 px = 2 * x + dx, py = 2 * y + dy;
+						if (px >= img->width || py >= img->height) continue;
+						sum += chroma(c, img->color[img->index[py * img->width + px]]);
+						k++;
+					}
+				}
+				if (pfmt == GF_PIXEL_YUV) planes[c * cw * ch + y * cw + x] = (u8) (sum / (256 * k));
+				else planes[y * 2 * cw + 2 * x + c] = (u8) (sum / (256 * k));
+			}
+		}
+	}
+	return frame;
+}
+
+u8 *ref_downscale(const RefImage *img, u32 scale, u32 pfmt, u32 *size)
+{
+	u32 w = (img->width + scale - 1) / scale, h = (img->height + scale - 1) / scale;
+	u32 p = ref_pixel_size(pfmt), x, y, i, j, c;
+	u8 *out = malloc(w * h * p);
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			u32 k = 0, n = 0;
+			u8 rgb[3];
+			for (j = y * scale; j < (y + 1) * scale && j < img->height; j++) {
+				for (i = x * scale; i < (x + 1) * scale && i < img->width; i++) {
+					n += img->index[j * img->width + i];
+					k++;
+				}
+			}
+			for (c = 0; c < 3; c++)
+				rgb[c] = (u8) ((img->color[0][c] * (k - n) + img->color[1][c] * n + k / 2) / k);
+			ref_format_color(pfmt, rgb, out + (y * w + x) * p);
+		}
+	}
+	*size = w * h * p;
+	return out;
+}
+
+/* length of [a0, a1) inside [b0, b1) */
+static u64 overlap(u64 a0, u64 a1, u64 b0, u64 b1)
+{
+	u64 lo = a0 > b0 ? a0 : b0, hi = a1 < b1 ? a1 : b1;
+	return hi > lo ? hi - lo : 0;
+}
+
+u8 *ref_resample(const RefImage *img, u32 w, u32 h, u32 pfmt, u32 *size)
+{
+	u32 p = ref_pixel_size(pfmt), x, y, i, j, c;
+	u64 area = (u64) img->width * img->height;
+	u8 *out = malloc(w * h * p);
+
+	/* source pixel x spans [x*w, (x+1)*w), output pixel o spans [o*width, (o+1)*width) */
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			u64 cover = 0;
+			u32 n;
+			u8 rgb[3];
+			/* only the source pixels that can overlap it */
+			u32 i0 = (u32) ((u64) x * img->width / w), i1 = (u32) (((u64) (x + 1) * img->width - 1) / w);
+			u32 j0 = (u32) ((u64) y * img->height / h), j1 = (u32) (((u64) (y + 1) * img->height - 1) / h);
+			for (j = j0; j <= j1; j++) {
+				u64 oy = overlap((u64) j * h, (u64) (j + 1) * h, (u64) y * img->height, (u64) (y + 1) * img->height);
+				for (i = i0; i <= i1; i++) {
+					if (img->index[j * img->width + i])
+						cover += oy * overlap((u64) i * w, (u64) (i + 1) * w, (u64) x * img->width, (u64) (x + 1) * img->width);
+				}
+			}
+			n = (u32) ((cover * 255 + area / 2) / area);
+			for (c = 0; c < 3; c++)
+				rgb[c] = (u8) ((img->color[0][c] * (255 - n) + img->color[1][c] * n + 127) / 255);
+			ref_format_color(pfmt, rgb, out + (y * w + x) * p);
+		}
+	}
+	*size = w * h * p;
+	return out;
+}
@@ -0,0 +1,41 @@
+/*
+ * Reference decoding for the tests: each output pixel is computed on its
+ * own from the BMP bits, with none of the tables or kernels of the filter.
+ */
+#ifndef BMP1BPP_REFERENCE_H
+#define BMP1BPP_REFERENCE_H
+
+#include <gpac/tools.h>
+
+typedef struct
+{
+	u32 width, height;
+	/* RGB of the palette entries 0 and 1 */
+	u8 color[2][3];
+	/* palette index of each pixel, top row first */
+	u8 *index;
+} RefImage;
+
+/* parses a 1bpp BMP as made by host_make_bmp, GF_FALSE if it is not one */
+Bool ref_load(RefImage *img, const u8 *bmp, u32 size);
+/* the w x h part of img at x, y, freed with ref_free */
+void ref_crop(const RefImage *img, u32 x, u32 y, u32 w, u32 h, RefImage *out);
+/* img with each pixel made a zoom x zoom block, freed with ref_free */
+void ref_zoom(const RefImage *img, u32 zoom, RefImage *out);
+/* one pixel of img in step, on one row in step, freed with ref_free */
+void ref_sample(const RefImage *img, u32 step, RefImage *out);
+void ref_free(RefImage *img);
+
+u32 ref_pixel_size(u32 pfmt);
+void ref_format_color(u32 pfmt, const u8 rgb[3], u8 *out);
+/* the whole image in pfmt, rows packed with no padding; YUV and NV12
+   chroma follows the luma plane */
+u8 *ref_expand(const RefImage *img, u32 pfmt, u32 *size);
+/* the image at 1/scale of its size, rounded up, each pixel mixing the two
+   colors by their share of its block; RGB and grey formats only */
+u8 *ref_downscale(const RefImage *img, u32 scale, u32 pfmt, u32 *size);
+/* the image resampled to w x h, each pixel mixing the two colors by the
+   share of the area it covers, in 255ths; RGB and grey formats only */
+u8 *ref_resample(const RefImage *img, u32 w, u32 h, u32 pfmt, u32 *size);
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * A long run of frames through the frame pool must keep the memory of the
+ * process flat, and finalize must give back every block the instance
+ * allocated.
+ *
+ * The filter is included rather than linked so that the allocation
+ * accounting of the instance can be read. That accounting only sees the
+ * filter's own blocks, so the resident size of the process is checked as
+ * well, which also covers packets, the host and heap fragmentation.
+ */
+#include "../BMP1BPP_filter.c"
+#include "gpac_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define NB_FRAMES	100000
+#define NB_WARMUP	1000
+/* one packet in this many is cut short and must give no frame */
+#define BAD_EVERY	997
+/* resident size allowed to appear after warm-up, a leak of a few bytes per frame goes past it */
+#define RSS_SLACK	(1024 * 1024)
+
+static const char *options[] = {
+	"threads=1",
+	"threads=0",
+	"nbframes=1",
+	"nbframes=0",
+	"lazy=true",
+	"packed=true",
+	"pfmt=nv12:lazy=true",
+	"stream=true",
+	"pfmt=yuv:strip=16",
+};
+#define NB_OPTIONS	(sizeof(options) / sizeof(options[0]))
+
+static u64 resident_size(void)
+{
+	unsigned long pages = 0, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (!f) return 0;
+	if (fscanf(f, "%lu %lu", &pages, &resident) != 2) resident = 0;
+	fclose(f);
+	return (u64) resident * (u64) sysconf(_SC_PAGESIZE);
+}
+
+static Bool soak(const char *opts, u8 **bmps, u32 *sizes)
+{
+	GF_Filter *filter = host_filter_new(&BMP1BPPRegister, opts);
+	GF_BaseFilter *stack;
+	HostOutput out;
+	u64 warm_bytes = 0, peak_bytes = 0, warm_rss = 0, end_rss;
+	u32 warm_allocs = 0, peak_allocs = 0, nb_rejected = 0, i;
+	Bool ok = GF_TRUE;
+
+	if (!filter) {
+		fprintf(stderr, "%s: cannot create the filter\n", opts);
+		return GF_FALSE;
+	}
+	stack = host_filter_udta(filter);
+	memset(&out, 0, sizeof(out));
+
+	for (i = 0; i < NB_FRAMES; i++) {
+		/* alternate two frame sizes, so that pooled frames do not always fit */
+		u32 image = i & 1;
+		u32 size = (i % BAD_EVERY == BAD_EVERY - 1) ? sizes[image] / 2 : sizes[image];
+		/* frames are read, so that lazy ones get expanded */
+		host_output_clear(&out);
+		host_filter_push(filter, bmps[image], size);
+		host_filter_run(filter, &out);
+		if (!out.nb_packets) nb_rejected++;
+
+		/* the decode threads are idle between packets */
+		if (i < NB_WARMUP) {
+			if (stack->bmp.Stats.LiveBytes > warm_bytes) warm_bytes = stack->bmp.Stats.LiveBytes;
+			if (stack->bmp.Stats.LiveAllocs > warm_allocs) warm_allocs = stack->bmp.Stats.LiveAllocs;
+			if (i == NB_WARMUP - 1) warm_rss = resident_size();
+		} else {
+			if (stack->bmp.Stats.LiveBytes > peak_bytes) peak_bytes = stack->bmp.Stats.LiveBytes;
+			if (stack->bmp.Stats.LiveAllocs > peak_allocs) peak_allocs = stack->bmp.Stats.LiveAllocs;
+		}
+	}
+	end_rss = resident_size();
+
+	if (nb_rejected != NB_FRAMES / BAD_EVERY) {
+		fprintf(stderr, "%s: %u packets gave no frame, %u expected\n", opts, nb_rejected, NB_FRAMES / BAD_EVERY);
+		ok = GF_FALSE;
+	}
+	if (peak_bytes > warm_bytes || peak_allocs > warm_allocs) {
+		fprintf(stderr, "%s: heap grew after warm-up, " LLU " bytes in %u blocks, up from " LLU " bytes in %u blocks\n",
+			opts, peak_bytes, peak_allocs, warm_bytes, warm_allocs);
+		ok = GF_FALSE;
+	}
+	if (!warm_rss || !end_rss) {
+		fprintf(stderr, "%s: cannot read the resident size of the process\n", opts);
+		ok = GF_FALSE;
+	} else if (end_rss > warm_rss + RSS_SLACK) {
+		fprintf(stderr, "%s: resident size grew from " LLU " to " LLU " bytes after warm-up\n", opts, warm_rss, end_rss);
+		ok = GF_FALSE;
+	}
+
+	/* the baseline is an instance that has not allocated anything yet */
+	host_filter_finalize(filter);
+	if (stack->bmp.Stats.LiveAllocs || stack->bmp.Stats.LiveBytes) {
+		fprintf(stderr, "%s: " LLU " bytes in %u blocks still allocated after finalize\n",
+			opts, stack->bmp.Stats.LiveBytes, stack->bmp.Stats.LiveAllocs);
+		ok = GF_FALSE;
+	}
+	if (ok)
+		printf("%s: %u frames, heap flat at " LLU " bytes in %u blocks, resident size " LLU " then " LLU " bytes, all freed at finalize\n",
+			opts, NB_FRAMES, warm_bytes, warm_allocs, warm_rss, end_rss);
+	host_filter_free(filter);
+	host_output_reset(&out);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	u8 *bmps[2];
+	u32 sizes[2], o;
+	Bool ok = GF_TRUE;
+
+	bmps[0] = host_make_bmp(64, 48, GF_FALSE, 11, &sizes[0]);
+	bmps[1] = host_make_bmp(40, 70, GF_TRUE, 12, &sizes[1]);
+	for (o = 0; o < NB_OPTIONS; o++)
+		if (!soak(options[o], bmps, sizes)) ok = GF_FALSE;
+	free(bmps[0]);
+	free(bmps[1]);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+/*
+ * Stream mode decodes unframed input as its blocks arrive. Whatever the
+ * block sizes, rows split across blocks and YUV row pairs included, the
+ * frames must match the reference decode. A file cut short by the start
+ * of the next one must be dropped without affecting the next.
+ */
+#include "gpac_host.h"
+#include "reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	4
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 13, 7, GF_FALSE }, { 70, 33, GF_TRUE }, { 300, 20, GF_FALSE },
+};
+
+static const char *formats[] = { "rgb", "grey", "rgb565", "yuv", "nv12" };
+static const u32 pfmts[] = { GF_PIXEL_RGB, GF_PIXEL_GREYSCALE, GF_PIXEL_RGB_565, GF_PIXEL_YUV, GF_PIXEL_NV12 };
+#define NB_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+/* block sizes, 0 for random sizes from 1 to 97 bytes */
+static const u32 blocks[] = { 1, 2, 7, 61, 4096, 0 };
+#define NB_BLOCKS	(sizeof(blocks) / sizeof(blocks[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static RefImage refs[NB_IMAGES];
+static u32 rand_state = 1;
+
+static u32 next_block(u32 block)
+{
+	if (block) return block;
+	rand_state = rand_state * 1103515245 + 12345;
+	return 1 + (rand_state >> 16) % 97;
+}
+
+/* queues a file as blocks, the first one flagged as the start of the file */
+static void push_file(GF_Filter *filter, const u8 *data, u32 size, u32 block)
+{
+	u32 offset = 0;
+	while (offset < size) {
+		u32 n = next_block(block);
+		if (n > size - offset) n = size - offset;
+		host_filter_push_block(filter, data + offset, n, offset == 0, offset + n == size);
+		offset += n;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	u32 i, f, b, nb_errors = 0, nb_runs = 0;
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 200 + i, &bmp_sizes[i]);
+		ref_load(&refs[i], bmps[i], bmp_sizes[i]);
+	}
+
+	for (f = 0; f < NB_FORMATS; f++) {
+		u8 *expected[NB_IMAGES];
+		u32 expected_sizes[NB_IMAGES];
+
+		for (i = 0; i < NB_IMAGES; i++)
+			expected[i] = ref_expand(&refs[i], pfmts[f], &expected_sizes[i]);
+
+		for (b = 0; b < NB_BLOCKS; b++) {
+			char args[64];
+			HostOutput out;
+			GF_Filter *filter;
+			u32 offset = 0;
+
+			snprintf(args, sizeof(args), "stream=true:pfmt=%s:threads=%u", formats[f], 1 + b % 3);
+			filter = host_filter_new(&BMP1BPPRegister, args);
+			if (!filter) {
+				fprintf(stderr, "%s: cannot create the filter\n", args);
+				return 1;
+			}
+			memset(&out, 0, sizeof(out));
+
+			/* the files back to back, then the first one cut short before the last one */
+			for (i = 0; i < NB_IMAGES; i++)
+				push_file(filter, bmps[i], bmp_sizes[i], blocks[b]);
+			push_file(filter, bmps[0], bmp_sizes[0] - 1, blocks[b]);
+			push_file(filter, bmps[NB_IMAGES - 1], bmp_sizes[NB_IMAGES - 1], blocks[b]);
+
+			if (host_filter_run(filter, &out) != GF_OK) {
+				fprintf(stderr, "%s, blocks of %u: decode failed\n", args, blocks[b]);
+				nb_errors++;
+			} else if (out.nb_packets != NB_IMAGES + 1) {
+				fprintf(stderr, "%s, blocks of %u: %u frames, %u expected\n", args, blocks[b], out.nb_packets, NB_IMAGES + 1);
+				nb_errors++;
+			} else {
+				for (i = 0; i <= NB_IMAGES; i++) {
+					u32 image = (i < NB_IMAGES) ? i : NB_IMAGES - 1;
+					if (offset + expected_sizes[image] > out.size || memcmp(out.data + offset, expected[image], expected_sizes[image])) {
+						fprintf(stderr, "%s, blocks of %u: frame %u differs from the reference\n", args, blocks[b], i);
+						nb_errors++;
+						break;
+					}
+					offset += expected_sizes[image];
+				}
+			}
+			host_filter_finalize(filter);
+			host_filter_free(filter);
+			host_output_reset(&out);
+			nb_runs++;
+		}
+		for (i = 0; i < NB_IMAGES; i++) free(expected[i]);
+	}
+
+	for (i = 0; i < NB_IMAGES; i++) {
+		ref_free(&refs[i]);
+		free(bmps[i]);
+	}
+	if (nb_errors) {
+		fprintf(stderr, "%u of %u stream runs failed\n", nb_errors, nb_runs);
+		return 1;
+	}
+	printf("%u stream runs match the reference\n", nb_runs);
+	return 0;
+}
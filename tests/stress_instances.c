@@ -0,0 +1,145 @@
+/*
+ * Several filter instances decoding at once, each from its own thread and
+ * with its own worker pool, must give the same output as one instance
+ * decoding alone on a single thread.
+ */
+#include "gpac_host.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern const GF_FilterRegister BMP1BPPRegister;
+
+#define NB_IMAGES	6
+#define NB_INSTANCES	16
+#define NB_ROUNDS	25
+
+static const struct
+{
+	u32 w, h;
+	Bool top_down;
+} images[NB_IMAGES] = {
+	{ 1, 1, GF_FALSE }, { 33, 7, GF_TRUE }, { 640, 480, GF_FALSE },
+	{ 1023, 257, GF_TRUE }, { 97, 1201, GF_FALSE }, { 2048, 64, GF_FALSE },
+};
+
+/* each option set is run by at least one instance */
+static const char *options[] = {
+	"bandpix=0",
+	"bandpix=1",
+	"bandpix=4096",
+	"nbframes=0",
+	"nbframes=1",
+	"lazy=true",
+	"lazy=true:nbframes=0",
+	"packed=true",
+	"pfmt=grey",
+	"pfmt=rgba:lazy=true",
+	"pfmt=rgb565:nbframes=0",
+	"pfmt=yuv",
+	"pfmt=nv12:lazy=true",
+	"pfmt=bgr:strip=16",
+	"pfmt=grey:tile=100x33:lazy=true",
+};
+#define NB_OPTIONS	(sizeof(options) / sizeof(options[0]))
+
+static u8 *bmps[NB_IMAGES];
+static u32 bmp_sizes[NB_IMAGES];
+static HostOutput refs[NB_OPTIONS][NB_IMAGES];
+
+typedef struct
+{
+	u32 index;
+	u32 nb_errors;
+} Instance;
+
+static GF_Err decode(const char *opts, u32 threads, GF_Filter **filter_p, u32 image, HostOutput *out)
+{
+	GF_Filter *filter = *filter_p;
+	if (!filter) {
+		char args[128];
+		snprintf(args, sizeof(args), "%s:threads=%u", opts, threads);
+		filter = *filter_p = host_filter_new(&BMP1BPPRegister, args);
+		if (!filter) return GF_BAD_PARAM;
+	}
+	host_filter_push(filter, bmps[image], bmp_sizes[image]);
+	return host_filter_run(filter, out);
+}
+
+static void *run_instance(void *par)
+{
+	Instance *inst = par;
+	u32 opt = inst->index % NB_OPTIONS;
+	GF_Filter *filter = NULL;
+	HostOutput out;
+	u32 r, i;
+
+	memset(&out, 0, sizeof(out));
+	for (r = 0; r < NB_ROUNDS; r++) {
+		for (i = 0; i < NB_IMAGES; i++) {
+			/* every instance walks the images in its own order */
+			u32 image = (i + inst->index + r) % NB_IMAGES;
+			host_output_clear(&out);
+			if (decode(options[opt], 2, &filter, image, &out) != GF_OK
+				|| out.size != refs[opt][image].size || memcmp(out.data, refs[opt][image].data, out.size)) {
+				if (!inst->nb_errors)
+					fprintf(stderr, "instance %u (%s): image %u differs in round %u\n", inst->index, options[opt], image, r);
+				inst->nb_errors++;
+			}
+		}
+	}
+	if (filter) {
+		host_filter_finalize(filter);
+		host_filter_free(filter);
+	}
+	host_output_reset(&out);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[NB_INSTANCES];
+	Instance instances[NB_INSTANCES];
+	u32 i, o, nb_errors = 0;
+
+	for (i = 0; i < NB_IMAGES; i++)
+		bmps[i] = host_make_bmp(images[i].w, images[i].h, images[i].top_down, 1 + i, &bmp_sizes[i]);
+
+	/* reference: one instance at a time, no decode threads */
+	for (o = 0; o < NB_OPTIONS; o++) {
+		GF_Filter *filter = NULL;
+		for (i = 0; i < NB_IMAGES; i++) {
+			if (decode(options[o], 1, &filter, i, &refs[o][i]) != GF_OK || !refs[o][i].size) {
+				fprintf(stderr, "reference decode failed: %s, image %u\n", options[o], i);
+				return 1;
+			}
+		}
+		host_filter_finalize(filter);
+		host_filter_free(filter);
+	}
+
+	for (i = 0; i < NB_INSTANCES; i++) {
+		instances[i].index = i;
+		instances[i].nb_errors = 0;
+		if (pthread_create(&threads[i], NULL, run_instance, &instances[i])) {
+			fprintf(stderr, "cannot start instance %u\n", i);
+			return 1;
+		}
+	}
+	for (i = 0; i < NB_INSTANCES; i++) {
+		pthread_join(threads[i], NULL);
+		nb_errors += instances[i].nb_errors;
+	}
+
+	for (o = 0; o < NB_OPTIONS; o++)
+		for (i = 0; i < NB_IMAGES; i++) host_output_reset(&refs[o][i]);
+	for (i = 0; i < NB_IMAGES; i++) free(bmps[i]);
+
+	if (nb_errors) {
+		fprintf(stderr, "%u decodes differ from the single-threaded reference\n", nb_errors);
+		return 1;
+	}
+	printf("%u instances x %u decodes match the single-threaded reference\n", NB_INSTANCES, NB_ROUNDS * NB_IMAGES);
+	return 0;
+}